@@ -1,17 +1,18 @@
 #!/usr/bin/env python3
 """
-Codegen parses C++ headers and generates ImGui editor code based on comment annotations.
+Codegen parses C++ headers and generates ImGui editor code and binary read/write functions based on comment
+annotations.
 
 Usage:
     python codegen.py input.hpp -o output.hpp
 
 Supported annotations:
     // @widget          - Custom widget template
-    // @imgui           - Mark struct/class for ImGui generation
+    // @imgui           - Mark struct/class for ImGui and binary serialization generation
     // @color           - Treat field as color
     // @range(min, max) - Lower/Upper bounds for sliders, drags, etc.
     // @readonly        - Display but don't allow editing
-    // @hide            - Skip this field entirely
+    // @hide            - Skip this field entirely, it is not serialized either
     // @rad2deg         - Field is stored in radians, display in degrees
     // @name("Display") - Custom display name
 """
@@ -50,6 +51,8 @@ class FieldAttribute(Enum):
     RAD2DEG = auto()  # FIXME: make it a template, that seems like a better way
     DEBUG_ONLY = auto()
     NDEBUG_ONLY = auto()
+    CONST = auto()
+    STATIC = auto()
 
 
 @dataclass
@@ -79,6 +82,19 @@ class FieldInfo:
     def ndebug_only(self) -> bool:
         return FieldAttribute.NDEBUG_ONLY in self.attributes
 
+    @property
+    def is_const(self) -> bool:
+        return FieldAttribute.CONST in self.attributes
+
+    @property
+    def is_static(self) -> bool:
+        return FieldAttribute.STATIC in self.attributes
+
+    @property
+    def serialized(self) -> bool:
+        # build-dependent fields are left out, so the data reads back the same in every configuration
+        return not (self.hidden or self.is_static or self.debug_only or self.ndebug_only)
+
 
 @dataclass
 class StructInfo:
@@ -94,6 +110,20 @@ class StructInfo:
             return f"{self.namespace}::{self.name}"
         return self.name
 
+    @property
+    def serialized_fields(self) -> list[FieldInfo]:
+        return [f for f in self.fields if f.serialized]
+
+    @property
+    def copyable_as_whole(self) -> bool:
+        """Every instance field is serialized, so a trivially copyable struct can be copied in one go."""
+        return all(f.serialized for f in self.fields if not f.is_static)
+
+    @property
+    def readable(self) -> bool:
+        """Const fields can only be set by a constructor, such structs only get a write function."""
+        return not any(f.is_const for f in self.serialized_fields)
+
 
 @dataclass
 class WidgetBinding:
@@ -288,6 +318,14 @@ def extract_type_name(type_node, source: bytes) -> str:
     return get_node_text(type_node, source).strip()
 
 
+def has_static_specifier(node, source: bytes) -> bool:
+    """Check if a field declaration is a static member."""
+    for child in node.children:
+        if child.type == 'storage_class_specifier' and get_node_text(child, source) == 'static':
+            return True
+    return False
+
+
 def has_const_qualifier(node, source: bytes) -> bool:
     """Check if a field declaration has const qualifier."""
     for child in node.children:
@@ -333,6 +371,10 @@ def parse_field_declaration(node, source: bytes, comments: list) -> Optional[Fie
 
     if is_const:
         field.attributes.add(FieldAttribute.READONLY)
+        field.attributes.add(FieldAttribute.CONST)
+
+    if has_static_specifier(node, source):
+        field.attributes.add(FieldAttribute.STATIC)
 
     preceding = find_preceding_comment(node, source, comments)
     if preceding:
@@ -639,7 +681,7 @@ def generate_code(structs: list[StructInfo], config: Config, opts: GeneratorOpti
 
 def main():
     parser = argparse.ArgumentParser(
-        description="Generate ImGui editor code from C++ headers",
+        description="Generate ImGui editor and binary serialization code from C++ headers",
         formatter_class=argparse.RawDescriptionHelpFormatter,
     )
 
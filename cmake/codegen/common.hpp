@@ -1,10 +1,110 @@
 #pragma once
 
+#include <types.hpp>
+
+#include <cpp/containers/stack_string.hpp>
+
+#include <cstring>
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace codegen
 {
     // Type name traits
     template<typename T>
     constexpr std::string_view type_name = "Unknown";
+
+    // output of the generated write functions
+    struct binary_writer
+    {
+        std::vector<u8> data;
+
+        void write(const void* src, const u64 size)
+        {
+            const u64 offset = data.size();
+            data.resize(offset + size);
+            std::memcpy(data.data() + offset, src, size);
+        }
+    };
+
+    // input of the generated read functions, reading past the end fails instead of touching the memory
+    struct binary_reader
+    {
+        const u8* data {nullptr};
+        u64 size {0};
+        u64 offset {0};
+
+        [[nodiscard]] bool read(void* dst, const u64 bytes)
+        {
+            if (bytes > size - offset)
+            {
+                return false;
+            }
+
+            std::memcpy(dst, data + offset, bytes);
+            offset += bytes;
+            return true;
+        }
+    };
+
+    // Field handlers the generated functions fall back to when a struct cannot be copied as a whole, the types
+    // without a handler here fail to compile instead of being written as raw memory.
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write_field(binary_writer& out, const T& value)
+    {
+        out.write(&value, sizeof(T));
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    [[nodiscard]] bool read_field(binary_reader& in, T& value)
+    {
+        return in.read(&value, sizeof(T));
+    }
+
+    // strings are stored as their length followed by the characters
+    template<size_t N>
+    void write_field(binary_writer& out, const cpp::stack_string_base<N>& value)
+    {
+        const u64 length = value.length();
+        out.write(&length, sizeof(length));
+        out.write(value.c_str(), length);
+    }
+
+    template<size_t N>
+    [[nodiscard]] bool read_field(binary_reader& in, cpp::stack_string_base<N>& value)
+    {
+        u64 length = 0;
+        if (!in.read(&length, sizeof(length)) || length >= N || length > in.size - in.offset)
+        {
+            return false;
+        }
+
+        value = cpp::stack_string_base<N>(reinterpret_cast<const char*>(in.data + in.offset), length);
+        in.offset += length;
+        return true;
+    }
+
+    inline void write_field(binary_writer& out, const std::string& value)
+    {
+        const u64 length = value.length();
+        out.write(&length, sizeof(length));
+        out.write(value.data(), length);
+    }
+
+    [[nodiscard]] inline bool read_field(binary_reader& in, std::string& value)
+    {
+        u64 length = 0;
+        if (!in.read(&length, sizeof(length)) || length > in.size - in.offset)
+        {
+            return false;
+        }
+
+        value.assign(reinterpret_cast<const char*>(in.data + in.offset), length);
+        in.offset += length;
+        return true;
+    }
 }
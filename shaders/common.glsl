@@ -10,6 +10,69 @@ vec3 transform_vec3(vec3 point, vec4 pos_and_scale, vec4 quat)
     return (point + 2.0 * cross(quat.xyz, cross(quat.xyz, point) + quat.w * point)) * pos_and_scale.w + pos_and_scale.xyz;
 }
 
+// object space box half extents rotated and scaled into view space, one axis per column
+mat3 view_box_axes(vec3 extent, vec4 pos_and_scale, vec4 quat, mat4 view)
+{
+    mat3 rotation = mat3(view) * pos_and_scale.w;
+    return mat3(rotation * quat_rotate_vec3(vec3(extent.x, 0.0F, 0.0F), quat),
+                rotation * quat_rotate_vec3(vec3(0.0F, extent.y, 0.0F), quat),
+                rotation * quat_rotate_vec3(vec3(0.0F, 0.0F, extent.z), quat));
+}
+
+// The sphere test of the cull passes for a view space box: the same symmetric side planes and depth range of
+// FrameCullData::frustum, with the box projected onto each plane normal instead of a radius
+bool box_in_frustum(vec3 c, mat3 axes, float frustum[6])
+{
+    vec3 x_normal = vec3(-frustum[0] * sign(c.x), 0.0F, frustum[1]);
+    vec3 y_normal = vec3(0.0F, -frustum[2] * sign(c.y), frustum[3]);
+
+    float x_radius = dot(abs(x_normal * axes), vec3(1.0F));
+    float y_radius = dot(abs(y_normal * axes), vec3(1.0F));
+    float z_radius = abs(axes[0].z) + abs(axes[1].z) + abs(axes[2].z);
+
+    return c.z * frustum[1] - abs(c.x) * frustum[0] > -x_radius
+        && c.z * frustum[3] - abs(c.y) * frustum[2] > -y_radius
+        && c.z - z_radius < -frustum[4] && c.z + z_radius > -frustum[5];
+}
+
+// octahedral mapping of a unit direction onto [0, 1]^2, the views of an impostor tile are laid out by it
+vec2 octahedral_encode(vec3 d)
+{
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    vec2 e = d.z >= 0.0F ? d.xy : (1.0F - abs(d.yx)) * vec2(d.x >= 0.0F ? 1.0F : -1.0F, d.y >= 0.0F ? 1.0F : -1.0F);
+    return e * 0.5F + 0.5F;
+}
+
+vec3 octahedral_decode(vec2 uv)
+{
+    vec2 e = uv * 2.0F - 1.0F;
+    vec3 d = vec3(e, 1.0F - abs(e.x) - abs(e.y));
+    float t = max(-d.z, 0.0F);
+    d.x += d.x >= 0.0F ? -t : t;
+    d.y += d.y >= 0.0F ? -t : t;
+    return normalize(d);
+}
+
+// object space direction towards the viewer of the impostor view in the given cell of the tile
+vec3 impostor_view_direction(uvec2 cell)
+{
+    return octahedral_decode((vec2(cell) + 0.5F) / float(kImpostorGridSize));
+}
+
+// screen axes of the impostor view looking along -d, shared by the bake and the impostor quads
+void impostor_view_axes(vec3 d, out vec3 right, out vec3 up)
+{
+    vec3 world_up = abs(d.y) > 0.999F ? vec3(0.0F, 0.0F, 1.0F) : vec3(0.0F, 1.0F, 0.0F);
+    right = normalize(cross(world_up, d));
+    up = cross(d, right);
+}
+
+// true for a view space sphere in front of the camera which projects to less than kImpostorPixelSize pixels
+bool impostor_sized(vec3 c, float r, float p11, float viewport_height)
+{
+    return -c.z > r && r * abs(p11) * viewport_height < kImpostorPixelSize * -c.z;
+}
+
 // 2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere. Michael Mara, Morgan McGuire. 2013
 // Adapted version from https://github.com/zeux/niagara
 bool project_sphere(vec3 c, float r, float znear, float P00, float P11, out vec4 aabb)
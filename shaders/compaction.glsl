@@ -0,0 +1,120 @@
+// Deterministic stream compaction for the cull passes.
+// Visibility is balloted into a single shared uint per workgroup, which gives every visible invocation its local
+// output offset. The workgroup's global offset comes from a decoupled look-back over the preceding tiles, so draw
+// commands are written in instance order and the only global atomic per workgroup is the tile ticket.
+//
+// Expects the including shader to declare, within a single storage buffer:
+//   uint draw_commands_count;
+//   uint scan_tile_counter;
+//   uint scan_tile_state[];
+// all of them zeroed before the dispatch. The total count name can be overridden by defining SCAN_TOTAL_COUNT.
+//
+// Several independent outputs can be compacted by the same workgroups by defining SCAN_STREAMS_COUNT, the tile
+// states are then interleaved per stream and SCAN_STORE_TOTAL(stream, total) must store each stream's total.
+//
+// scan_compact_atomic is the per-invocation atomicAdd the cull passes used before the scan, kept behind
+// kAtomicCompactionBit to compare both on the same scene. It appends through SCAN_ATOMIC_APPEND(stream), which must
+// be overridden along with SCAN_STORE_TOTAL for several streams.
+
+#ifndef SCAN_TOTAL_COUNT
+#define SCAN_TOTAL_COUNT draw_commands_count
+#endif
+
+#ifndef SCAN_STREAMS_COUNT
+#define SCAN_STREAMS_COUNT 1
+#endif
+
+#ifndef SCAN_STORE_TOTAL
+#define SCAN_STORE_TOTAL(stream, total) SCAN_TOTAL_COUNT = (total)
+#endif
+
+#ifndef SCAN_ATOMIC_APPEND
+#define SCAN_ATOMIC_APPEND(stream) atomicAdd(SCAN_TOTAL_COUNT, 1)
+#endif
+
+const uint kScanFlagAggregate = 1; // tile published its own visible count
+const uint kScanFlagPrefix    = 2; // tile published the inclusive count of all tiles up to and including itself
+
+shared uint scan_tile_id;
+shared uint scan_ballot[SCAN_STREAMS_COUNT];
+shared uint scan_base;
+
+// Tiles are handed out in launch order rather than by gl_WorkGroupID, so every tile a look-back waits on is
+// guaranteed to be already running
+uint scan_acquire_tile()
+{
+    if (gl_LocalInvocationIndex == 0)
+    {
+        scan_tile_id = atomicAdd(scan_tile_counter, 1);
+        for (uint stream = 0; stream < SCAN_STREAMS_COUNT; ++stream)
+        {
+            scan_ballot[stream] = 0;
+        }
+    }
+
+    barrier();
+    return scan_tile_id;
+}
+
+// Returns the output slot of the invocation within the stream (only meaningful if visible), must be reached by the
+// whole workgroup, once per stream
+uint scan_compact(uint stream, bool visible, uint tile, uint tiles_count)
+{
+    if (visible)
+    {
+        atomicOr(scan_ballot[stream], 1u << gl_LocalInvocationIndex);
+    }
+
+    barrier();
+    const uint ballot = scan_ballot[stream];
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        const uint aggregate = bitCount(ballot);
+        atomicExchange(scan_tile_state[tile * SCAN_STREAMS_COUNT + stream], (aggregate << 2) | kScanFlagAggregate);
+
+        uint exclusive = 0;
+        int lookback = int(tile) - 1;
+        while (lookback >= 0)
+        {
+            const uint state = atomicOr(scan_tile_state[uint(lookback) * SCAN_STREAMS_COUNT + stream], 0u);
+            const uint flag = state & 3u;
+
+            // predecessor has not published anything yet, spin on it
+            if (flag == 0)
+            {
+                continue;
+            }
+
+            exclusive += state >> 2;
+            if (flag == kScanFlagPrefix)
+            {
+                break;
+            }
+
+            --lookback;
+        }
+
+        atomicExchange(scan_tile_state[tile * SCAN_STREAMS_COUNT + stream], ((exclusive + aggregate) << 2) | kScanFlagPrefix);
+        scan_base = exclusive;
+
+        if (tile == tiles_count - 1)
+        {
+            SCAN_STORE_TOTAL(stream, exclusive + aggregate);
+        }
+    }
+
+    barrier();
+    return scan_base + bitCount(ballot & ((1u << gl_LocalInvocationIndex) - 1u));
+}
+
+uint scan_compact(bool visible, uint tile, uint tiles_count)
+{
+    return scan_compact(0, visible, tile, tiles_count);
+}
+
+// Output order is arbitrary and every visible invocation contends on the stream total, which must be zeroed
+uint scan_compact_atomic(uint stream, bool visible)
+{
+    return visible ? SCAN_ATOMIC_APPEND(stream) : 0;
+}
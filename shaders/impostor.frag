@@ -0,0 +1,19 @@
+#version 460
+
+layout (binding = 3) uniform sampler2D impostor_atlas;
+
+layout (location = 0) in vec2 i_atlas_texel;
+
+layout (location = 0) out vec4 o_frag_color;
+
+void main()
+{
+    vec4 texel = texture(impostor_atlas, i_atlas_texel / vec2(textureSize(impostor_atlas, 0)));
+    if (texel.a < 0.5F)
+    {
+        discard;
+    }
+
+    // object space normal, as meshlets.frag outputs it for the full geometry
+    o_frag_color = vec4(normalize(texel.xyz * 2.0F - 1.0F), 1.0F);
+}
@@ -0,0 +1,64 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "types.glsl"
+#include "common.glsl"
+
+// One camera facing quad per instance routed to the impostors by the cull passes, drawn with the view of the
+// instance's impostor tile closest to the camera direction
+layout (binding = 0) readonly buffer MeshesData
+{
+    MeshData meshes_data[];
+};
+
+layout (binding = 1) readonly buffer MeshesTransforms
+{
+    MeshTransform meshes_transforms[];
+};
+
+layout (binding = 2) readonly buffer ImpostorInstanceIds
+{
+    uint impostor_instance_ids[];
+};
+
+layout (push_constant) uniform constants
+{
+    mat4 vp;
+    vec4 camera_pos;
+} pc;
+
+layout (location = 0) out vec2 o_atlas_texel;
+
+// two counter-clockwise triangles, corner bits: x - right, y - down
+const uint kQuadCorners[6] = uint[6](0u, 2u, 1u, 1u, 2u, 3u);
+
+void main()
+{
+    uint mesh_id = impostor_instance_ids[gl_InstanceIndex];
+    MeshTransform transform = meshes_transforms[mesh_id];
+
+    vec3 center = vec3(meshes_data[mesh_id].center[0], meshes_data[mesh_id].center[1], meshes_data[mesh_id].center[2]);
+    vec3 world_center = transform_vec3(center, transform.pos_and_scale, transform.rotation_quat);
+    float radius = meshes_data[mesh_id].radius * transform.pos_and_scale.w;
+
+    // the views are baked in object space, so the camera direction is rotated back into it
+    vec4 inverse_quat = vec4(-transform.rotation_quat.xyz, transform.rotation_quat.w);
+    vec3 to_camera = quat_rotate_vec3(normalize(pc.camera_pos.xyz - world_center), inverse_quat);
+    uvec2 cell = min(uvec2(octahedral_encode(to_camera) * float(kImpostorGridSize)), uvec2(kImpostorGridSize - 1));
+
+    vec3 right, up;
+    impostor_view_axes(impostor_view_direction(cell), right, up);
+
+    uint corner_bits = kQuadCorners[gl_VertexIndex];
+    vec2 corner = vec2(corner_bits & 1u, corner_bits >> 1);
+
+    uint geometry_id = meshes_data[mesh_id].geometry_id;
+    uvec2 tile = uvec2(geometry_id % kImpostorTilesPerRow, geometry_id / kImpostorTilesPerRow);
+    o_atlas_texel = vec2(tile * kImpostorTileSize + cell * kImpostorViewSize) + corner * float(kImpostorViewSize);
+
+    vec3 offset = right * (corner.x * 2.0F - 1.0F) + up * (1.0F - corner.y * 2.0F);
+    vec3 world_pos = world_center + quat_rotate_vec3(offset, transform.rotation_quat) * radius;
+
+    gl_Position = pc.vp * vec4(world_pos, 1.0F);
+}
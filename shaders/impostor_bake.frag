@@ -0,0 +1,11 @@
+#version 460
+
+layout (location = 0) in vec3 i_normal;
+
+layout (location = 0) out vec4 o_frag_color;
+
+void main()
+{
+    // alpha marks the texels covered by the geometry, the atlas is cleared to zero
+    o_frag_color = vec4(normalize(i_normal) * 0.5F + 0.5F, 1.0F);
+}
@@ -0,0 +1,44 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "types.glsl"
+#include "common.glsl"
+
+// Renders one view of a geometry into its impostor tile, see render::bake_impostor_atlas
+layout (binding = 0) readonly buffer VertexPositions
+{
+    uint vertex_positions[];
+};
+
+layout (binding = 1) readonly buffer VertexAttributes
+{
+    uint vertex_attributes[];
+};
+
+layout (push_constant) uniform constants
+{
+    vec4 sphere;           // object space bounding sphere, the view covers it exactly
+    vec4 position_bounds;  // static_model::position_bounds
+    uvec4 cell;            // xy - view within the tile
+} pc;
+
+layout (location = 0) out vec3 o_normal;
+
+void main()
+{
+    const uint vid = uint(gl_VertexIndex);
+
+    float bounds[4] = float[4](pc.position_bounds.x, pc.position_bounds.y, pc.position_bounds.z, pc.position_bounds.w);
+    vec3 local_pos = decode_vertex_position(LOAD_VERTEX_POSITION(vertex_positions, vid), bounds);
+    vec3 p = (local_pos - pc.sphere.xyz) / pc.sphere.w;
+
+    vec3 right, up;
+    vec3 d = impostor_view_direction(pc.cell.xy);
+    impostor_view_axes(d, right, up);
+
+    o_normal = decode_vertex_normal(LOAD_VERTEX_NORMAL(vertex_attributes, vid));
+
+    // orthographic, y flipped and reverse Z like the scene projection
+    gl_Position = vec4(dot(p, right), -dot(p, up), dot(p, d) * 0.5F + 0.5F, 1.0F);
+}
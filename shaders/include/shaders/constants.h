@@ -14,15 +14,51 @@ namespace shader_constants
     const uint kOcclusionCullBit      = 3;
     const uint kMeshletConeCullBit    = 4;
     const uint kMeshletFrustumCullBit = 5;
+    const uint kTriangleCullBit       = 7;
+    const uint kDepthOnlyOccludersBit = 8;  // set by the host, the second cull phase then emits all visible draws
+    const uint kImpostorsBit          = 9;  // set by the host, tiny instances are drawn as impostors, see below
+    const uint kAtomicCompactionBit   = 10; // set by the host, cull passes append draws with atomics instead of a scan
+    const uint kBoxCullBit            = 11; // set by the host, instances passing the sphere test also test their box
 
-    const uint kMaxVerticesPerMeshlet  = 64;
-    const uint kMaxTrianglesPerMeshlet = 94;
+// Meshlet shader variants override these per render::kMeshletConfigs entry, the defaults match its first one
+#ifndef MESHLET_MAX_VERTICES
+#define MESHLET_MAX_VERTICES 64
+#endif
+#ifndef MESHLET_MAX_TRIANGLES
+#define MESHLET_MAX_TRIANGLES 96
+#endif
+#ifndef MESHLET_TASK_WORK_GROUP_SIZE
+#define MESHLET_TASK_WORK_GROUP_SIZE 32
+#endif
+#ifndef MESHLET_MESH_WORK_GROUP_SIZE
+#define MESHLET_MESH_WORK_GROUP_SIZE 32
+#endif
+
+    const uint kMaxVerticesPerMeshlet  = MESHLET_MAX_VERTICES;
+    const uint kMaxTrianglesPerMeshlet = MESHLET_MAX_TRIANGLES;
     const uint kMaxIndicesPerMeshlet   = kMaxTrianglesPerMeshlet * 3;
 
     const uint kLODCount = 8;
 
-    const uint kTaskWorkGroups = 32;
-    const uint kMeshWorkGroups = 32;
+    const uint kTaskWorkGroups = MESHLET_TASK_WORK_GROUP_SIZE;
+    const uint kMeshWorkGroups = MESHLET_MESH_WORK_GROUP_SIZE;
+
+    // cull passes rely on a 32-wide workgroup to ballot visibility into a single uint
+    const uint kCullWorkGroupSize = 32;
+
+    // octahedral impostors: every geometry gets a tile of kImpostorGridSize^2 views in the atlas, instances whose
+    // bounding sphere projects to less than kImpostorPixelSize pixels are drawn as a single quad of the closest view
+    const uint kImpostorGridSize    = 8;
+    const uint kImpostorViewSize    = 32;
+    const uint kImpostorTileSize    = kImpostorGridSize * kImpostorViewSize;
+    const uint kImpostorTilesPerRow = 16;
+    const float kImpostorPixelSize  = 16.0F;
+
+    // draw sort: 16-bit quantized view depth keys, sorted one 8-bit digit per radix pass
+    const uint kDrawSortKeyBits        = 16;
+    const uint kRadixSortDigitBits     = 8;
+    const uint kRadixSortBucketsCount  = 1u << kRadixSortDigitBits;
+    const uint kRadixSortWorkGroupSize = kRadixSortBucketsCount;
 #ifdef __cplusplus
 }
 #endif
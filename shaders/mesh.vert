@@ -5,9 +5,9 @@
 #include "types.glsl"
 #include "common.glsl"
 
-layout (binding = 0) readonly buffer Vertices
+layout (binding = 0) readonly buffer VertexPositions
 {
-    Vertex vertices[];
+    uint vertex_positions[];
 };
 
 layout (binding = 1) readonly buffer MeshesTransforms
@@ -15,16 +15,39 @@ layout (binding = 1) readonly buffer MeshesTransforms
     MeshTransform meshes_transforms[];
 };
 
+#ifdef INSTANCED_DRAW
+layout (binding = 2) readonly buffer DrawInstanceIds
+{
+    uint draw_instance_ids[];
+};
+#else
 layout (binding = 2) readonly buffer DrawIndexedIndirects
 {
     DrawIndexedIndirect draw_cmds[];
 };
+#endif
+
+layout (binding = 3) readonly buffer MeshesData
+{
+    MeshData meshes_data[];
+};
+
+#ifndef DEPTH_ONLY
+layout (binding = 4) readonly buffer VertexAttributes
+{
+    uint vertex_attributes[];
+};
+#endif
 
 layout (push_constant) uniform constants
 {
     mat4 vp;
 } pc;
 
+// the color pass redraws depth-only occluders with an equal depth test, both variants must match bit for bit
+invariant gl_Position;
+
+#ifndef DEPTH_ONLY
 out VS_OUT {
     layout (location = 0) out vec2 uv;
     layout (location = 1) out vec3 normal;
@@ -35,26 +58,34 @@ out VS_OUT {
     layout (location = 5) out flat uint meshlet_id;
 #endif
 } vs_out;
+#endif
 
 void main()
 {
-    Vertex v = vertices[gl_VertexIndex];
+    const uint vid = uint(gl_VertexIndex);
 
-    vec3 local_pos = vec3(v.px, v.py, v.pz);
+#ifdef INSTANCED_DRAW
+    // gl_InstanceIndex already includes the bin's first_instance offset
+    uint mesh_id = draw_instance_ids[gl_InstanceIndex];
+#else
     uint mesh_id = draw_cmds[gl_DrawID].mesh_id;
+#endif
+
+    vec3 local_pos = decode_vertex_position(LOAD_VERTEX_POSITION(vertex_positions, vid), meshes_data[mesh_id].position_bounds);
+    vec4 world_pos = vec4(transform_vec3(local_pos, meshes_transforms[mesh_id].pos_and_scale, meshes_transforms[mesh_id].rotation_quat), 1.0);
 
-    vs_out.world_pos = vec4(transform_vec3(local_pos, meshes_transforms[mesh_id].pos_and_scale, meshes_transforms[mesh_id].rotation_quat), 1.0);
-    vs_out.normal = vec3(v.nx, v.ny, v.nz);
+#ifndef DEPTH_ONLY
+    vs_out.world_pos = world_pos;
+    vs_out.normal = decode_vertex_normal(LOAD_VERTEX_NORMAL(vertex_attributes, vid));
 
 #if 0
-    vs_out.uv = vec2(v.ux, v.uy);
-    vs_out.tangent = vec3(v.tx, v.ty, v.tz);
-    vs_out.bitangent = cross(vs_out.tangent, vs_out.normal);
+    vs_out.uv = decode_vertex_uv(LOAD_VERTEX_UV(vertex_attributes, vid));
 #endif
 
 #if VISUALIZE_MESHLETS
     vs_out.meshlet_id = gl_VertexIndex;
+#endif
 #endif
 
-    gl_Position = pc.vp * vs_out.world_pos;
+    gl_Position = pc.vp * world_pos;
 }
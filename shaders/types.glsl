@@ -2,32 +2,43 @@
 
 #include "include/shaders/constants.h"
 
-struct Vertex
-{
-    float px, py, pz;
-    float nx, ny, nz;
-    #if 0
-    float ux, uy;
-    float tx, ty, tz;
-    #endif
-};
+// Vertex streams are tightly packed 16-bit values, so they are bound as raw words and unpacked by byte offset.
+#define LOAD_U16(words, byte_offset) (((words)[(byte_offset) >> 2] >> (((byte_offset) & 2u) << 3)) & 0xFFFFu)
+
+// static_model::packed_position, unorm16 x3
+#define VERTEX_POSITION_STRIDE 6u
+#define LOAD_VERTEX_POSITION(positions, vid)                        \
+    uvec3(LOAD_U16(positions, (vid) * VERTEX_POSITION_STRIDE),      \
+          LOAD_U16(positions, (vid) * VERTEX_POSITION_STRIDE + 2u), \
+          LOAD_U16(positions, (vid) * VERTEX_POSITION_STRIDE + 4u))
+
+// static_model::packed_attributes, snorm8 x2 octahedral normal, half x2 uv
+#if 0
+#define VERTEX_ATTRIBUTES_STRIDE 6u
+#define LOAD_VERTEX_UV(attributes, vid)                                \
+    uvec2(LOAD_U16(attributes, (vid) * VERTEX_ATTRIBUTES_STRIDE + 2u), \
+          LOAD_U16(attributes, (vid) * VERTEX_ATTRIBUTES_STRIDE + 4u))
+#else
+#define VERTEX_ATTRIBUTES_STRIDE 2u
+#endif
+#define LOAD_VERTEX_NORMAL(attributes, vid) LOAD_U16(attributes, (vid) * VERTEX_ATTRIBUTES_STRIDE)
 
+// static_model::meshlet
 struct Meshlet
 {
-    uint data_offset;// offset (in bytes) into a shader vertices/indices array
-    float cone_axis[3];
-    float cone_cutoff;
-    float sphere_center[3];
-    float sphere_radius;
-    uint8_t vertices_count;
-    uint8_t triangles_count;
+    uint data_offset;     // offset (in bytes) into a shader vertices/indices array
+    uint base_vertex;     // payload vertex references are relative to it
+    uint sphere_xy;       // unorm16 x2 within the mesh position bounds
+    uint sphere_z_radius; // unorm16 z, unorm16 radius of the bounds extent
+    uint cone;            // snorm8 x3 axis, snorm8 cutoff
+    uint counts;          // u8 vertices count, u8 triangles count, u8 wide vertex references
 };
 
 struct MeshletTask
 {
     uint mesh_id;
     uint base_vertex;
-    uint meshlet_ids[kMaxVerticesPerMeshlet];
+    uint meshlet_ids[kTaskWorkGroups];
 };
 
 struct LODData
@@ -37,17 +48,42 @@ struct LODData
     uint base_index;
     uint indices_count;
     float error;
+    uint short_indices; // 1 if the indices are u16 and base_index points into the 16-bit index pool
+    uint base_vertex;   // added to MeshData::base_vertex, lods may fetch a compacted copy of their vertices
 };
 
 struct MeshData
 {
     float center[3];
     float radius;
+    float position_bounds[4]; // xyz - min corner, w - largest extent
+    float aabb_center[3];     // object space box
+    float aabb_extent[3];     // half extents
     uint base_vertex;
     uint lod_count;
+    uint geometry_id;
     LODData lod_array[kLODCount];
 };
 
+// see render::vk_geometry_relocation, deltas are in elements of each pool and in bytes for the meshlets payload
+struct GeometryRelocation
+{
+    int vertex_delta;
+    int index_delta;
+    int index16_delta;
+    int meshlet_delta;
+    int payload_delta;
+    uint base_meshlet;
+    uint meshlets_count;
+    uint padding;
+};
+
+struct InstanceCluster
+{
+    float center[3];
+    float radius;
+};
+
 struct MeshTransform
 {
     vec4 pos_and_scale; // xyz - position, w - uniform scale
@@ -71,13 +107,87 @@ struct DrawIndexedIndirect
     uint mesh_id;
 };
 
+// see transform_update in main.cpp
+struct TransformUpdate
+{
+    uint index;
+    uint padding[3];
+    MeshTransform transform;
+};
+
+// VkDrawIndirectCommand, the impostor quads are drawn with a single one
+struct DrawIndirect
+{
+    uint vertex_count;
+    uint instance_count;
+    uint first_vertex;
+    uint first_instance;
+};
+
 struct FrameCullData
 {
     mat4 view;
     float frustum[6]; // left/right/top/bottom/znear/zfar
     vec2 pyramid_size;
+    vec2 viewport_size;
     float p00;
     float p11;
     uint draw_count;
     uint flags;
+    uint visible_instances; // counted by the second cull phase, read back by the host
 };
+
+// position - LOAD_VERTEX_POSITION result
+vec3 decode_vertex_position(uvec3 position, float bounds[4])
+{
+    return vec3(bounds[0], bounds[1], bounds[2]) + vec3(position) / 65535.0F * bounds[3];
+}
+
+// normal - LOAD_VERTEX_NORMAL result
+vec3 decode_vertex_normal(uint normal)
+{
+    vec2 e = max(unpackSnorm4x8(normal).xy, vec2(-1.0F));
+    vec3 n = vec3(e, 1.0F - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0F);
+    n.x += n.x >= 0.0F ? -t : t;
+    n.y += n.y >= 0.0F ? -t : t;
+    return normalize(n);
+}
+
+uint meshlet_vertices_count(Meshlet m)
+{
+    return m.counts & 0xFFu;
+}
+
+uint meshlet_triangles_count(Meshlet m)
+{
+    return (m.counts >> 8) & 0xFFu;
+}
+
+// size in bytes of a single vertex reference in the meshlet payload
+uint meshlet_vertex_ref_size(Meshlet m)
+{
+    return ((m.counts >> 16) & 0xFFu) != 0 ? 4 : 2;
+}
+
+// xyz - center, w - radius, in mesh local space
+vec4 decode_meshlet_sphere(Meshlet m, float bounds[4])
+{
+    vec3 center = vec3(unpackUnorm2x16(m.sphere_xy), float(m.sphere_z_radius & 0xFFFFu) / 65535.0F);
+    float radius = float(m.sphere_z_radius >> 16) / 65535.0F;
+    return vec4(vec3(bounds[0], bounds[1], bounds[2]) + center * bounds[3], radius * bounds[3]);
+}
+
+// xyz - axis, w - cutoff
+vec4 decode_meshlet_cone(Meshlet m)
+{
+    return unpackSnorm4x8(m.cone);
+}
+
+#if 0
+// uv - LOAD_VERTEX_UV result
+vec2 decode_vertex_uv(uvec2 uv)
+{
+    return unpackHalf2x16(uv.x | (uv.y << 16));
+}
+#endif
@@ -2,63 +2,64 @@
 #include <assert2.hpp>
 #include <cpp/alg_constexpr.hpp>
 
+#include <algorithm>
 #include <cassert>
 
-u64 align(const u64 addr, const u8 alignment)
+namespace
+{
+    // stored right before the aligned pointer
+    struct allocation_header
+    {
+        u64 offset {0};  // from the start of the underlying allocation to the aligned pointer
+        u64 size {0};
+    };
+
+    allocation_header* get_header(void* ptr)
+    {
+        return static_cast<allocation_header*>(ptr) - 1;
+    }
+}
+
+u64 align(const u64 addr, const u64 alignment)
 {
     const u64 mask = alignment - 1;
-    assert2((alignment & mask) == 0);
+    assert2(alignment != 0 && (alignment & mask) == 0);
 
     return (addr + mask) & ~mask;
 }
 
 template<typename T>
-T* align_ptr(T* ptr, const u8 alignment)
+T* align_ptr(T* ptr, const u64 alignment)
 {
     const auto addr = reinterpret_cast<u64>(ptr);
     return reinterpret_cast<T*>(align(addr, alignment));
 }
 
-// TODO: this version is a bit wasteful with extra alignment bytes, so maybe it makes sense to investigate alternative
-// approaches
-// TODO: also, only alignment up to 255 bytes is supported, and it seems VK may require much more (up to 64K it seems)
-void* alloc_aligned(const u64 size, const u8 alignment)
+// the padding is at most alignment - 1 bytes on top of the header, whatever the alignment
+void* alloc_aligned(const u64 size, const u64 alignment)
 {
-    constexpr u64 header_size = sizeof(u64);
-    const u64 total_bytes     = header_size + size + alignment;
+    constexpr u64 header_size = sizeof(allocation_header);
+    const u64 total_bytes     = header_size + size + alignment - 1;
 
-    auto* p            = new u8[total_bytes];
-    auto* p_header_off = p + header_size;
-    u8* p_aligned      = align_ptr(p_header_off, alignment);
+    auto* p        = new u8[total_bytes];
+    u8* p_aligned  = align_ptr(p + header_size, alignment);
+    auto* p_header = get_header(p_aligned);
 
-    if (p_header_off == p_aligned)
-    {
-        p_aligned += alignment;
-    }
-
-    // save diff to the original pointer
-    const i64 diff = p_aligned - p;
-    assert2(diff >= 0 && diff < 0xFF);  // 0xFF = 255 = 2^8 - 1
-    p_aligned[-1] = static_cast<u8>(diff & 0xFF);
-
-    // save total allocation size
-    auto* p_header_dst = reinterpret_cast<u64*>(p_aligned - 1 - header_size);
-    p_header_dst[0]    = size;
+    p_header->offset = static_cast<u64>(p_aligned - p);
+    p_header->size   = size;
 
     return p_aligned;
 }
 
-void* realloc_aligned(void* memory, const u64 size, const u8 alignment)
+void* realloc_aligned(void* memory, const u64 size, const u64 alignment)
 {
     if (!memory)
     {
         return nullptr;
     }
 
-    constexpr u64 header_size = sizeof(u64);
-
     auto* new_memory        = alloc_aligned(size, alignment);
-    const u64 original_size = reinterpret_cast<u64*>(static_cast<u8*>(memory) - header_size - 1)[0];
+    const u64 original_size = get_header(memory)->size;
 
     cpp::cx_memcpy(new_memory, memory, std::min(original_size, size));
     free_aligned(memory);
@@ -70,10 +71,7 @@ void free_aligned(void* ptr)
 {
     if (ptr)
     {
-        const auto* p_aligned = static_cast<u8*>(ptr);
-        const i64 diff        = p_aligned[-1];
-
-        const u8* p = p_aligned - diff;
+        const u8* p = static_cast<u8*>(ptr) - get_header(ptr)->offset;
         delete[] p;
     }
 }
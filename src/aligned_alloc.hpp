@@ -2,6 +2,9 @@
 
 #include <types.hpp>
 
+// alignment is any power of two
+u64 align(u64 addr, u64 alignment);
+
 void free_aligned(void* ptr);
-void* alloc_aligned(u64 size, u8 alignment);
-void* realloc_aligned(void* memory, u64 size, u8 alignment);
+void* alloc_aligned(u64 size, u64 alignment);
+void* realloc_aligned(void* memory, u64 size, u64 alignment);
@@ -0,0 +1,194 @@
+#include <assert2.hpp>
+#include <cpp/containers/stack_string.hpp>
+#include <cpp/jobs/job_system.hpp>
+
+namespace
+{
+    // pool the current thread works for and the queue it owns in it
+    thread_local const cpp::job_system* t_pool = nullptr;
+    thread_local u32 t_queue_index            = 0;
+}
+
+u32 cpp::task_graph::add(job_function task)
+{
+    m_nodes.emplace_back();
+    m_nodes.back().task = std::move(task);
+    return size() - 1;
+}
+
+void cpp::task_graph::precede(const u32 before, const u32 after)
+{
+    assert2(before < size() && after < size() && before != after);
+    m_nodes[before].successors.push_back(after);
+    ++m_nodes[after].predecessors;
+}
+
+cpp::job_system::job_system(const u32 workers_count)
+{
+    m_queues.reserve(workers_count + 1);
+    for (u32 i = 0; i <= workers_count; ++i)
+    {
+        m_queues.push_back(std::make_unique<job_queue>());
+    }
+
+    m_workers.reserve(workers_count);
+    for (u32 i = 0; i < workers_count; ++i)
+    {
+        m_workers.emplace_back(&job_system::worker_loop, this, i);
+    }
+}
+
+// the jobs still queued are dropped, their counters have to be waited on before
+cpp::job_system::~job_system()
+{
+    {
+        std::lock_guard lock(m_sleep_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void cpp::job_system::run(job_function job, job_counter& counter)
+{
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    push({.function = std::move(job), .counter = &counter});
+}
+
+void cpp::job_system::run(task_graph& graph, job_counter& counter)
+{
+    ZoneScoped;
+
+    // every node is accounted for up front, so that the counter cannot drop to zero between two nodes
+    counter.pending.fetch_add(graph.size(), std::memory_order_relaxed);
+    for (auto& node : graph.m_nodes)
+    {
+        node.predecessors_left.store(node.predecessors, std::memory_order_relaxed);
+    }
+
+    for (u32 i = 0; i < graph.size(); ++i)
+    {
+        if (graph.m_nodes[i].predecessors == 0)
+        {
+            push({.function = [this, &graph, i, &counter] { run_node(graph, i, counter); }, .counter = &counter});
+        }
+    }
+}
+
+void cpp::job_system::wait(job_counter& counter)
+{
+    ZoneScoped;
+
+    while (counter.pending.load(std::memory_order_acquire) != 0)
+    {
+        if (!try_run_one())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void cpp::job_system::push(job&& queued)
+{
+    const u32 index = t_pool == this ? t_queue_index : static_cast<u32>(m_queues.size() - 1);
+    {
+        std::lock_guard lock(m_queues[index]->mutex);
+        m_queues[index]->jobs.push_back(std::move(queued));
+    }
+
+    m_queued.fetch_add(1, std::memory_order_release);
+
+    // a worker that just found nothing to run is either asleep already or still checks m_queued under the mutex
+    {
+        std::lock_guard lock(m_sleep_mutex);
+    }
+
+    m_wake.notify_one();
+}
+
+bool cpp::job_system::try_run_one()
+{
+    const auto queues_count = static_cast<u32>(m_queues.size());
+    const u32 own_index     = t_pool == this ? t_queue_index : queues_count - 1;
+
+    job next;
+    bool found = false;
+    for (u32 i = 0; i < queues_count && !found; ++i)
+    {
+        job_queue& queue = *m_queues[(own_index + i) % queues_count];
+
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty())
+        {
+            continue;
+        }
+
+        // the owner takes its newest job, which data is likely still in its caches, thieves take the oldest one
+        if (i == 0)
+        {
+            next = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else
+        {
+            next = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+
+        found = true;
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+
+    next.function();
+    next.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void cpp::job_system::run_node(task_graph& graph, const u32 index, job_counter& counter)
+{
+    auto& node = graph.m_nodes[index];
+    node.task();
+
+    // the successors are queued before this node counts as done
+    for (const u32 successor : node.successors)
+    {
+        if (graph.m_nodes[successor].predecessors_left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            push({.function = [this, &graph, successor, &counter] { run_node(graph, successor, counter); },
+                  .counter  = &counter});
+        }
+    }
+}
+
+void cpp::job_system::worker_loop(const u32 index)
+{
+    t_pool        = this;
+    t_queue_index = index;
+
+    tracy::SetThreadName(cpp::stack_string::make_formatted("job worker %u", index).c_str());
+
+    while (true)
+    {
+        if (try_run_one())
+        {
+            continue;
+        }
+
+        std::unique_lock lock(m_sleep_mutex);
+        m_wake.wait(lock, [this] { return m_stop || m_queued.load(std::memory_order_acquire) != 0; });
+        if (m_stop)
+        {
+            return;
+        }
+    }
+}
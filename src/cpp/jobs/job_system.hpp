@@ -0,0 +1,139 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cpp
+{
+    using job_function = std::function<void()>;
+
+    // jobs of a batch that did not finish yet, see job_system::wait
+    struct job_counter
+    {
+        std::atomic<u32> pending {0};
+    };
+
+    // Tasks with dependencies between them, a task is queued once every task it depends on finished.
+    // Built on a single thread, then run once with job_system::run.
+    class task_graph
+    {
+    public:
+        u32 add(job_function task);
+
+        // after starts only once before finished
+        void precede(u32 before, u32 after);
+
+        [[nodiscard]] u32 size() const
+        {
+            return static_cast<u32>(m_nodes.size());
+        }
+
+    private:
+        friend class job_system;
+
+        struct node
+        {
+            job_function task;
+            std::vector<u32> successors;
+            u32 predecessors {0};
+            std::atomic<u32> predecessors_left {0};
+        };
+
+        std::deque<node> m_nodes;  // the nodes never move, their counters are shared with the workers
+    };
+
+    // Work-stealing thread pool. Every worker pops its own queue from the back and steals from the front of the
+    // others once it runs dry. Threads outside of the pool queue their jobs to a shared queue and run jobs while they
+    // wait, so a pool without workers runs everything on the waiting thread.
+    class job_system
+    {
+    public:
+        explicit job_system(u32 workers_count = default_workers_count());
+        ~job_system();
+
+        job_system(const job_system&)            = delete;
+        job_system& operator=(const job_system&) = delete;
+
+        // one worker per core, the thread that waits takes the remaining one
+        static u32 default_workers_count()
+        {
+            return std::max(std::thread::hardware_concurrency(), 1U) - 1;
+        }
+
+        [[nodiscard]] u32 workers_count() const
+        {
+            return static_cast<u32>(m_workers.size());
+        }
+
+        void run(job_function job, job_counter& counter);
+
+        // the roots are queued right away, the graph and the counter have to outlive the run
+        void run(task_graph& graph, job_counter& counter);
+
+        // runs queued jobs on the calling thread until the counter drops to zero
+        void wait(job_counter& counter);
+
+        // Calls f(i) for every i in [0, count), batch_size indices per job. Returns once every call finished, the
+        // calling thread runs batches as well.
+        template<typename F>
+        void parallel_for(const u64 count, const u64 batch_size, F&& f)
+        {
+            ZoneScoped;
+
+            job_counter counter;
+            for (u64 begin = 0; begin < count; begin += batch_size)
+            {
+                const u64 end = std::min(begin + batch_size, count);
+                run(
+                    [&f, begin, end]
+                    {
+                        for (u64 i = begin; i < end; ++i)
+                        {
+                            f(i);
+                        }
+                    },
+                    counter);
+            }
+
+            wait(counter);
+        }
+
+    private:
+        struct job
+        {
+            job_function function;
+            job_counter* counter {nullptr};
+        };
+
+        struct job_queue
+        {
+            std::mutex mutex;
+            std::deque<job> jobs;
+        };
+
+        void push(job&& queued);
+        bool try_run_one();
+        void run_node(task_graph& graph, u32 index, job_counter& counter);
+        void worker_loop(u32 index);
+
+        // one per worker, followed by the one shared by the threads outside of the pool
+        std::vector<std::unique_ptr<job_queue>> m_queues;
+        std::vector<std::thread> m_workers;
+
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_wake;
+        std::atomic<u32> m_queued {0};
+        bool m_stop {false};  // guarded by m_sleep_mutex
+    };
+}
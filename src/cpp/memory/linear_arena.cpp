@@ -0,0 +1,142 @@
+#include <aligned_alloc.hpp>
+#include <assert2.hpp>
+#include <cpp/memory/linear_arena.hpp>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+cpp::linear_arena::linear_arena(const u64 block_size)
+    : m_block_size(block_size)
+{
+}
+
+cpp::linear_arena::~linear_arena()
+{
+    release_blocks();
+}
+
+cpp::linear_arena::linear_arena(linear_arena&& other) noexcept
+    : m_block(std::exchange(other.m_block, nullptr))
+    , m_offset(std::exchange(other.m_offset, 0))
+    , m_block_size(other.m_block_size)
+{
+}
+
+cpp::linear_arena& cpp::linear_arena::operator=(linear_arena&& other) noexcept
+{
+    if (this != &other)
+    {
+        release_blocks();
+        m_block      = std::exchange(other.m_block, nullptr);
+        m_offset     = std::exchange(other.m_offset, 0);
+        m_block_size = other.m_block_size;
+    }
+
+    return *this;
+}
+
+void* cpp::linear_arena::allocate(const u64 size, const u64 alignment)
+{
+    if (m_block)
+    {
+        auto* data        = reinterpret_cast<u8*>(m_block + 1);
+        const u64 aligned = align(reinterpret_cast<u64>(data) + m_offset, alignment) - reinterpret_cast<u64>(data);
+        if (aligned + size <= m_block->size)
+        {
+            m_offset = aligned + size;
+            return data + aligned;
+        }
+    }
+
+    // the new block fits the allocation whatever the alignment of its start
+    push_block(std::max(m_block_size, size + alignment - 1));
+
+    auto* data        = reinterpret_cast<u8*>(m_block + 1);
+    const u64 aligned = align(reinterpret_cast<u64>(data), alignment) - reinterpret_cast<u64>(data);
+
+    m_offset = aligned + size;
+    return data + aligned;
+}
+
+void cpp::linear_arena::reset()
+{
+    if (!m_block || !m_block->previous)
+    {
+        m_offset = 0;
+        return;
+    }
+
+    ZoneScopedN("linear_arena: merge blocks");
+
+    // the next round fits in a single block
+    u64 total_size = 0;
+    for (const block_header* block = m_block; block; block = block->previous)
+    {
+        total_size += block->size;
+    }
+
+    release_blocks();
+    m_block_size = std::max(m_block_size, total_size);
+    push_block(m_block_size);
+}
+
+void cpp::linear_arena::rewind(const marker to)
+{
+    if (!to.block)
+    {
+        reset();
+        return;
+    }
+
+    while (m_block != to.block)
+    {
+        block_header* previous = m_block->previous;
+        free_aligned(m_block);
+        m_block = previous;
+    }
+
+    m_offset = to.offset;
+}
+
+u64 cpp::linear_arena::used() const
+{
+    return m_block ? m_block->used_before + m_offset : 0;
+}
+
+u32 cpp::linear_arena::blocks_count() const
+{
+    u32 count = 0;
+    for (const block_header* block = m_block; block; block = block->previous)
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+cpp::linear_arena& cpp::thread_scratch_arena()
+{
+    thread_local linear_arena arena;
+    return arena;
+}
+
+void cpp::linear_arena::push_block(const u64 min_size)
+{
+    void* memory = alloc_aligned(sizeof(block_header) + min_size, kBlockAlignment);
+    m_block      = new (memory) block_header {.previous = m_block, .size = min_size, .used_before = used()};
+    m_offset     = 0;
+}
+
+void cpp::linear_arena::release_blocks()
+{
+    while (m_block)
+    {
+        block_header* previous = m_block->previous;
+        free_aligned(m_block);
+        m_block = previous;
+    }
+
+    m_offset = 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <vector>
+
+namespace cpp
+{
+    // Bump allocator over a chain of blocks, its allocations are released all at once. An allocation that does not fit
+    // the current block chains a new one. Reset merges the chain into a single block that fits everything the arena
+    // held, so in the steady state a reset only moves the offset back.
+    class linear_arena
+    {
+    public:
+        constexpr static u64 kDefaultBlockSize = 256 * 1024;
+
+        // position to rewind the arena to, reset invalidates it
+        struct marker
+        {
+            const void* block {nullptr};
+            u64 offset {0};
+        };
+
+        // the first block is allocated on the first allocation
+        explicit linear_arena(u64 block_size = kDefaultBlockSize);
+        ~linear_arena();
+
+        linear_arena(linear_arena&& other) noexcept;
+        linear_arena& operator=(linear_arena&& other) noexcept;
+
+        linear_arena(const linear_arena&)            = delete;
+        linear_arena& operator=(const linear_arena&) = delete;
+
+        // alignment is any power of two, never returns null
+        [[nodiscard]] void* allocate(u64 size, u64 alignment);
+
+        template<typename T>
+        [[nodiscard]] T* allocate(const u64 count)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void reset();
+
+        // the marker of an empty arena has no block, the blocks may be merged by the time it is rewound to
+        [[nodiscard]] marker get_marker() const
+        {
+            return used() == 0 ? marker {} : marker {.block = m_block, .offset = m_offset};
+        }
+
+        // Releases everything allocated after the marker, along with the blocks chained since. Rewinding to an empty
+        // arena resets it instead, so that the blocks chained meanwhile are merged rather than freed.
+        void rewind(marker to);
+
+        // bytes handed out since the last reset, alignment padding included
+        [[nodiscard]] u64 used() const;
+
+        [[nodiscard]] u32 blocks_count() const;
+
+    private:
+        // blocks start on a cache line, the allocations up to that alignment never pad the start of a block
+        constexpr static u64 kBlockAlignment = 64;
+
+        struct alignas(kBlockAlignment) block_header
+        {
+            block_header* previous {nullptr};
+            u64 size {0};         // of the memory that follows the header
+            u64 used_before {0};  // by the blocks before this one
+        };
+
+        void push_block(u64 min_size);
+        void release_blocks();
+
+        block_header* m_block {nullptr};  // the current one, the others are chained through previous
+        u64 m_offset {0};
+        u64 m_block_size {kDefaultBlockSize};
+    };
+
+    // std allocator over an arena, for containers that do not outlive the next reset or rewind of the arena
+    template<typename T>
+    struct arena_allocator
+    {
+        using value_type = T;
+
+        linear_arena* arena {nullptr};
+
+        arena_allocator(linear_arena& arena)
+            : arena(&arena)
+        {
+        }
+
+        template<typename U>
+        arena_allocator(const arena_allocator<U>& other)
+            : arena(other.arena)
+        {
+        }
+
+        [[nodiscard]] T* allocate(const u64 count)
+        {
+            return arena->allocate<T>(count);
+        }
+
+        void deallocate(T*, u64)
+        {
+        }
+
+        template<typename U>
+        bool operator==(const arena_allocator<U>& other) const
+        {
+            return arena == other.arena;
+        }
+    };
+
+    template<typename T>
+    using arena_vector = std::vector<T, arena_allocator<T>>;
+
+    // Arena of the calling thread, for temporaries taken under a scratch_scope. It keeps its memory for the lifetime
+    // of the thread, so the next scopes reuse the pages the previous ones touched.
+    [[nodiscard]] linear_arena& thread_scratch_arena();
+
+    // temporaries of a single scope on a longer-lived arena, released when the scope ends
+    class scratch_scope
+    {
+    public:
+        explicit scratch_scope(linear_arena& arena)
+            : m_arena(arena)
+            , m_marker(arena.get_marker())
+        {
+        }
+
+        ~scratch_scope()
+        {
+            m_arena.rewind(m_marker);
+        }
+
+        scratch_scope(const scratch_scope&)            = delete;
+        scratch_scope& operator=(const scratch_scope&) = delete;
+
+        [[nodiscard]] linear_arena& arena() const
+        {
+            return m_arena;
+        }
+
+    private:
+        linear_arena& m_arena;
+        linear_arena::marker m_marker;
+    };
+}
@@ -4,4 +4,7 @@ namespace debug
 {
     void break_into_debugger();
     bool is_debugger_present();
+
+    // plots the global operator new calls since the previous call, once per frame (TRACY_ENABLE only)
+    void plot_frame_heap_allocations();
 }
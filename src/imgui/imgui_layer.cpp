@@ -1,5 +1,6 @@
 #include <backends/imgui_impl_sdl3.h>
 #include <backends/imgui_impl_vulkan.h>
+#include <cpp/memory/linear_arena.hpp>
 #include <imgui.h>
 #include <imgui/imgui_layer.hpp>
 
@@ -217,7 +218,7 @@ void imgui_layer::flush_pending(const VkCommandBuffer cmd)
         return;
     }
 
-    std::vector<VkImageMemoryBarrier2> barriers(m_pending_uploads.size());
+    cpp::arena_vector<VkImageMemoryBarrier2> barriers(m_pending_uploads.size(), m_renderer.get_frame_arena());
 
     for (u32 i = 0; i < m_pending_uploads.size(); ++i)
     {
@@ -11,6 +11,9 @@
 #include <codegen/imgui/gpu_profile_data.hpp>
 #include <codegen/render_settings.hpp>
 #include <codegen/scene/components.hpp>
+#include <cpp/hash/crc_hash.hpp>
+#include <cpp/jobs/job_system.hpp>
+#include <debug.hpp>
 #include <events.hpp>
 #include <fs/fs.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -19,28 +22,53 @@
 #include <imgui/imex.hpp>
 #include <imgui/imgui_layer.hpp>
 #include <render/debug/frustum_renderer.hpp>
+#include <render/draw_sort.hpp>
+#include <render/impostor_atlas.hpp>
+#include <render/instance_slots.hpp>
+#include <render/meshlet_config.hpp>
+#include <render/model_registry.hpp>
 #include <render/platform/vk/vk_barrier.hpp>
 #include <render/platform/vk/vk_image.hpp>
 #include <render/platform/vk/vk_pipeline.hpp>
 #include <render/platform/vk/vk_query.hpp>
 #include <render/platform/vk/vk_renderer.hpp>
+#include <render/sm_cache.hpp>
 #include <scene/components.hpp>
 #include <scene/entity.hpp>
 #include <scene/scene.hpp>
+#include <scene/serializer.hpp>
+#include <shaders/constants.h>
 #include <tracy/Tracy.hpp>
 #include <window.hpp>
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #define NO_EDITOR          0
 #define NO_PERF_QUERY      0
 #define TEST_MULTI_OBJECTS 0
 
+#if MESHLET_BENCHMARK && NO_PERF_QUERY
+#error "The meshlet benchmark measures frames with timestamp queries"
+#endif
+
 struct pc_data
 {
     glm::mat4 pv;
 };
 
+struct impostor_pc_data
+{
+    glm::mat4 pv;
+    vec4 camera_position;
+};
+
 struct draw_task_indirect_cmd
 {
     u32 work_group_count[3];
@@ -63,10 +91,12 @@ struct frame_cull_data
     glm::mat4 view;
     float frustum[6];  // left/right/top/bottom/znear/zfar
     vec2 pyramid_size;
+    vec2 viewport_size;
     float p00;
     float p11;
     u32 draw_count;
     u32 flags;
+    u32 visible_instances;  // counted by the second cull phase
 
     frame_cull_data& build_frustum(const glm::mat4& iproj, const glm::mat4& iview)
     {
@@ -114,6 +144,17 @@ struct depth_pyramid_data
     u32 pyramid_count {0};
 };
 
+// Hardware-instanced indexed path: one draw per (geometry, lod) bin, with visible instance ids written by the cull pass
+struct instanced_draw_data
+{
+    render::vk_buffer bins;           // draw commands, instance_count is accumulated by the cull pass
+    render::vk_buffer bins_template;  // pristine bins with zero instance counts, copied over bins on reset
+    render::vk_buffer instance_ids;   // per-bin ranges of visible instance ids, starting at bin first_instance
+    u32 bins_count {0};
+
+    std::vector<u32> geometry_capacity;  // ids reserved per bin of every geometry, rebuilt once a geometry outgrows it
+};
+
 struct pipeline_statistics_data
 {
     u64 input_assembly_vertices {0};
@@ -121,10 +162,53 @@ struct pipeline_statistics_data
     u64 vertex_shader_invocations {0};
     u64 triangles_count {0};
     u64 fragment_shader_invocations {0};
+
+    pipeline_statistics_data& operator+=(const pipeline_statistics_data& rhs)
+    {
+        input_assembly_vertices += rhs.input_assembly_vertices;
+        input_assembly_primitives += rhs.input_assembly_primitives;
+        vertex_shader_invocations += rhs.vertex_shader_invocations;
+        triangles_count += rhs.triangles_count;
+        fragment_shader_invocations += rhs.fragment_shader_invocations;
+        return *this;
+    }
+};
+
+// A frame figure averaged over the same frames with a render option off and on. While it runs the camera is frozen and
+// the option is toggled every frame, a change of the draw path or the cull flags starts it over.
+struct frame_comparison
+{
+    bool running {false};
+    u64 draw_path {0};
+    u64 totals[2] {};  // option off, on
+    u32 frames[2] {};
+
+    [[nodiscard]] bool enabled_frame() const
+    {
+        return ((frames[0] + frames[1]) & 1) != 0;
+    }
+
+    [[nodiscard]] f64 average(const bool enabled) const
+    {
+        return static_cast<f64>(totals[enabled]) / static_cast<f64>(std::max(frames[enabled], 1U));
+    }
+
+    void add(const bool enabled, const u64 value)
+    {
+        totals[enabled] += value;
+        ++frames[enabled];
+    }
+
+    void restart(const u64 path)
+    {
+        draw_path = path;
+        std::fill_n(totals, 2, 0);
+        std::fill_n(frames, 2, 0);
+    }
 };
 
-void begin_rendering(VkCommandBuffer cmd, VkImageView color, VkImageView depth, VkAttachmentLoadOp load_op,
-                     VkAttachmentStoreOp store_op, const VkRect2D& vp)
+void begin_rendering(VkCommandBuffer cmd, VkImageView color, VkImageView depth, VkAttachmentLoadOp color_load_op,
+                     VkAttachmentLoadOp depth_load_op, VkAttachmentStoreOp store_op, const VkRect2D& vp)
 {
     VkRenderingInfo rendering_info {.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR, .renderArea = vp, .layerCount = 1};
 
@@ -136,7 +220,7 @@ void begin_rendering(VkCommandBuffer cmd, VkImageView color, VkImageView depth,
             .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
             .imageView   = color,
             .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR,
-            .loadOp      = load_op,
+            .loadOp      = color_load_op,
             .storeOp     = store_op,
             .clearValue  = {
                             .color = {0.0F, 0.0F, 0.0F, 1.0F},
@@ -153,7 +237,7 @@ void begin_rendering(VkCommandBuffer cmd, VkImageView color, VkImageView depth,
             .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
             .imageView   = depth,
             .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-            .loadOp      = load_op,
+            .loadOp      = depth_load_op,
             .storeOp     = store_op,
             .clearValue  = {
                             .depthStencil = {0.0F, 0},
@@ -177,21 +261,91 @@ void reset_draw_count_buffer(VkCommandBuffer cmd, const render::vk_buffer& draw_
                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
 }
 
+void reset_instanced_bins(VkCommandBuffer cmd, const instanced_draw_data& instanced_data)
+{
+    const VkBufferCopy region {.size = instanced_data.bins.size};
+    vkCmdCopyBuffer(cmd, instanced_data.bins_template.buffer, instanced_data.bins.buffer, 1, &region);
+    render::cmd_buffer_barrier(cmd,
+                               instanced_data.bins.buffer,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void reset_impostor_draw(VkCommandBuffer cmd, const render::impostor_draw_data& impostors)
+{
+    const VkDrawIndirectCommand command {.vertexCount = 6, .instanceCount = 0, .firstVertex = 0, .firstInstance = 0};
+    vkCmdUpdateBuffer(cmd, impostors.draw.buffer, 0, sizeof(command), &command);
+    render::cmd_buffer_barrier(cmd,
+                               impostors.draw.buffer,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void draw_impostors(VkCommandBuffer cmd, const render::vk_pipeline& pipeline,
+                    const render::impostor_draw_data& impostors, const render::vk_buffer& meshes_data,
+                    const render::vk_buffer& meshes_transforms, const glm::mat4& pv, const vec3& camera_position)
+{
+    const render::vk_descriptor_info bindings[] = {
+        meshes_data.buffer,
+        meshes_transforms.buffer,
+        impostors.instance_ids.buffer,
+        render::vk_descriptor_info(
+            impostors.atlas.sampler, impostors.atlas.image.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+    };
+
+    pipeline.bind(cmd);
+    pipeline.push_descriptor_set(cmd, bindings);
+    pipeline.push_constant(cmd, impostor_pc_data {.pv = pv, .camera_position = vec4(camera_position, 1.0F)});
+    vkCmdDrawIndirect(cmd, impostors.draw.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void draw_scene_instanced(VkCommandBuffer cmd, const render::vk_pipeline& pipeline,
+                          const render::vk_scene_geometry_pool& geometry_pool, const render::vk_buffer& meshes_data,
+                          const render::vk_buffer& meshes_transforms, const instanced_draw_data& instanced_data)
+{
+    const render::vk_descriptor_info render_bindings[] = {geometry_pool.position.buffer.buffer,
+                                                          meshes_transforms.buffer,
+                                                          instanced_data.instance_ids.buffer,
+                                                          meshes_data.buffer,
+                                                          geometry_pool.attribute.buffer.buffer};
+    pipeline.push_descriptor_set(cmd, render_bindings);
+
+    // empty bins keep instance_count = 0, so no draw count buffer is needed
+    // u32 and u16 bins alternate, so each index type walks every other bin
+    constexpr u32 kBinsStride = 2 * sizeof(draw_indexed_indirect);
+
+    vkCmdBindIndexBuffer(cmd, geometry_pool.index.buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(cmd, instanced_data.bins.buffer, 0, instanced_data.bins_count / 2, kBinsStride);
+
+    vkCmdBindIndexBuffer(cmd, geometry_pool.index16.buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdDrawIndexedIndirect(cmd,
+                             instanced_data.bins.buffer,
+                             sizeof(draw_indexed_indirect),
+                             instanced_data.bins_count / 2,
+                             kBinsStride);
+}
+
 void draw_scene(const bool use_meshlets, VkCommandBuffer cmd, const render::vk_pipeline& pipeline,
                 const render::vk_scene_geometry_pool& geometry_pool, const render::vk_buffer& meshes_data,
                 const render::vk_buffer& meshes_transforms, const render::vk_buffer& draw_count_buffer,
-                const render::vk_buffer& draw_indirect_cmds_buffer,
+                const render::vk_buffer& draw_indirect_cmds_buffer, const render::vk_buffer& draw_count_buffer_16,
+                const render::vk_buffer& draw_indirect_cmds_buffer_16,
                 const render::vk_mapped_buffer& frame_cull_data_buffer, u32 max_draws)
 {
     if (use_meshlets)
     {
-        const render::vk_descriptor_info render_bindings[] = {geometry_pool.vertex.buffer.buffer,
+        const render::vk_descriptor_info render_bindings[] = {geometry_pool.position.buffer.buffer,
                                                               geometry_pool.meshlets.buffer.buffer,
                                                               geometry_pool.meshlets_payload.buffer.buffer,
                                                               meshes_data.buffer,
                                                               meshes_transforms.buffer,
                                                               draw_indirect_cmds_buffer.buffer,
-                                                              frame_cull_data_buffer.buffer};
+                                                              frame_cull_data_buffer.buffer,
+                                                              geometry_pool.attribute.buffer.buffer};
 
         pipeline.push_descriptor_set(cmd, render_bindings);
         vkCmdDrawMeshTasksIndirectCountEXT(cmd,
@@ -204,8 +358,12 @@ void draw_scene(const bool use_meshlets, VkCommandBuffer cmd, const render::vk_p
     }
     else
     {
-        const render::vk_descriptor_info render_bindings[] = {
-            geometry_pool.vertex.buffer.buffer, meshes_transforms.buffer, draw_indirect_cmds_buffer.buffer};
+        // depth-only pipelines have no binding for the attribute stream and ignore it
+        const render::vk_descriptor_info render_bindings[] = {geometry_pool.position.buffer.buffer,
+                                                              meshes_transforms.buffer,
+                                                              draw_indirect_cmds_buffer.buffer,
+                                                              meshes_data.buffer,
+                                                              geometry_pool.attribute.buffer.buffer};
         pipeline.push_descriptor_set(cmd, render_bindings);
         vkCmdBindIndexBuffer(cmd, geometry_pool.index.buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
         vkCmdDrawIndexedIndirectCount(cmd,
@@ -215,9 +373,55 @@ void draw_scene(const bool use_meshlets, VkCommandBuffer cmd, const render::vk_p
                                       0,
                                       max_draws,
                                       sizeof(draw_indexed_indirect));
+
+        // the cull pass compacts lods with u16 indices into a second stream, gl_DrawID restarts with it
+        const render::vk_descriptor_info render_bindings_16[] = {geometry_pool.position.buffer.buffer,
+                                                                 meshes_transforms.buffer,
+                                                                 draw_indirect_cmds_buffer_16.buffer,
+                                                                 meshes_data.buffer,
+                                                                 geometry_pool.attribute.buffer.buffer};
+        pipeline.push_descriptor_set(cmd, render_bindings_16);
+        vkCmdBindIndexBuffer(cmd, geometry_pool.index16.buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+        vkCmdDrawIndexedIndirectCount(cmd,
+                                      draw_indirect_cmds_buffer_16.buffer,
+                                      0,
+                                      draw_count_buffer_16.buffer,
+                                      0,
+                                      max_draws,
+                                      sizeof(draw_indexed_indirect));
     }
 }
 
+void cull_clusters(VkCommandBuffer cmd, const render::vk_pipeline& pipeline,
+                   const render::instance_clusters_data& clusters_data,
+                   const render::vk_mapped_buffer& frame_cull_data_buffer,
+                   const render::vk_buffer& mesh_visibility_buffer)
+{
+    vkCmdFillBuffer(cmd, clusters_data.dispatch.buffer, 0, clusters_data.dispatch.size, 0);
+    render::cmd_buffer_barrier(cmd,
+                               clusters_data.dispatch.buffer,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    const render::vk_descriptor_info bindings[] = {clusters_data.clusters.buffer,
+                                                   frame_cull_data_buffer.buffer,
+                                                   clusters_data.visible_clusters.buffer,
+                                                   clusters_data.dispatch.buffer,
+                                                   mesh_visibility_buffer.buffer};
+    pipeline.bind(cmd);
+    pipeline.push_descriptor_set(cmd, bindings);
+    pipeline.push_constant(cmd, clusters_data.clusters_count);
+    pipeline.dispatch(cmd, clusters_data.clusters_count, 1, 1);
+
+    render::cmd_stage_barrier(cmd,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                              VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+}
+
 f64 bytes_to_mb(u64 bytes)
 {
     return static_cast<f64>(bytes) / (1024.0 * 1024);
@@ -321,11 +525,13 @@ cpp::stack_string format_big_number(u64 number)
 
 void draw_shared_buffer_stats(const char* label, const render::vk_shared_buffer& buffer)
 {
-    ImGui::TextWrapped("%s buffer: %lf MB used (%lf MB total, %lf%%)",
+    ImGui::TextWrapped("%s buffer: %lf MB used (%lf MB total, %lf%%), %zu free ranges, largest %lf MB",
                        label,
-                       bytes_to_mb(buffer.offset),
+                       bytes_to_mb(buffer.used),
                        bytes_to_mb(buffer.size),
-                       static_cast<f64>(buffer.offset) * 100.0 / buffer.size);
+                       static_cast<f64>(buffer.used) * 100.0 / buffer.size,
+                       buffer.free_ranges.size(),
+                       bytes_to_mb(buffer.largest_free_range()));
 }
 
 f32 get_random_f32(const f32 min, const f32 max)
@@ -338,33 +544,45 @@ i32 get_random_i32(const i32 min, const i32 max)
     return min + static_cast<int>(get_random_f32(0.0F, 1.0F) * static_cast<f32>(max - min));
 }
 
-u64 populate_scene(const u32 draw_count, const char* models[], u32 models_count, scene& scene,
-                   render::vk_scene_geometry_pool& geometry_pool)
+// keep the reference counts of the registry in step with the static_model_component of the scene
+void acquire_model(render::model_registry& scene_models, entt::registry& registry, const entt::entity entity)
+{
+    scene_models.acquire(registry.get<static_model_component>(entity).handle);
+}
+
+void release_model(render::model_registry& scene_models, entt::registry& registry, const entt::entity entity)
+{
+    scene_models.release(registry.get<static_model_component>(entity).handle);
+}
+
+void populate_scene(const u32 draw_count, const char* models[], u32 models_count, scene& scene,
+                    render::vk_scene_geometry_pool& geometry_pool, render::model_registry& scene_models,
+                    cpp::job_system& jobs)
 {
     ZoneScoped;
 
-    u64 scene_triangles_total = 0;
-    std::vector<static_model> unique_models;
+    std::vector<u32> model_handles;
     const u32 kVolumeItemsPerSide = std::cbrtl(draw_count);
 
     for (u32 i = 0; i < models_count; i++)
     {
         ZoneScopedN("load all models");
-        auto&& loaded = *static_model::load(models[i], geometry_pool);
-        unique_models.insert(unique_models.end(), loaded.begin(), loaded.end());
+        const auto handles = *scene_models.load(models[i], geometry_pool, jobs);
+        model_handles.insert(model_handles.end(), handles.begin(), handles.end());
     }
 
+    // the components are built up front and the entities spawned in bulk, one storage insert per component type
+    std::vector<static_model_component> model_components;
+    std::vector<transform_component> transforms(draw_count);
+    std::vector<id_component> ids(draw_count);
+    model_components.reserve(draw_count);
+
     for (u32 i = 0; i < draw_count; ++i)
     {
-        ZoneScopedN("create models within the scene");
-        auto& model = unique_models[get_random_i32(0, models_count - 1)];
-        scene_triangles_total += model.lod_array[0].indices_count / 3;
+        const u32 handle = model_handles[get_random_i32(0, models_count - 1)];
+        model_components.push_back(static_model_component {.handle = handle});
 
-        auto entity = scene.create_entity();
-        entity.add_component<static_model_component>(model);
-        entity.add_component<id_component>();
-
-        auto& transform = entity.emplace_component<transform_component>();
+        auto& transform = transforms[i];
 
         transform.position = {
             i % kVolumeItemsPerSide,
@@ -390,43 +608,307 @@ u64 populate_scene(const u32 draw_count, const char* models[], u32 models_count,
 #endif
     }
 
-    return scene_triangles_total;
+    scene.create_entities<static_model_component, id_component, transform_component>(
+        draw_count, model_components, ids, transforms);
+}
+
+// The file populate_scene bakes its scene to. The name hashes what the placement depends on, so a different draw
+// count, seed or model list bakes a new scene instead of loading a stale one. Bump kPopulateVersion along with any
+// change to the placement itself.
+fs::path baked_scene_path(const char* name, const u32 draw_count, const u32 seed, const char* models[],
+                          const u32 models_count)
+{
+    constexpr u32 kPopulateVersion = 1;
+    const u32 parameters[]         = {kPopulateVersion, draw_count, seed};
+
+    u64 hash = cpp::crc::crc64(reinterpret_cast<const char*>(parameters), sizeof(parameters));
+    for (u32 i = 0; i < models_count; ++i)
+    {
+        hash = cpp::crc::crc64(models[i], std::strlen(models[i]), hash);
+    }
+
+    return fs::path_string::make_formatted(
+        ".scene_cache/%s_%016llx.scene", name, static_cast<unsigned long long>(hash));
+}
+
+// Loads the models with a growing number of workers and writes the best load time of each worker count to a csv.
+// The first load of every worker count is not timed, it builds the vertex caches and warms up the file cache.
+void benchmark_model_loading(const char* models[], u32 models_count, render::vk_scene_geometry_pool& geometry_pool)
+{
+    ZoneScoped;
+
+    constexpr u32 kTimedLoads = 5;
+    constexpr const char* kLoaderBenchmarkRecordPath = "loader_benchmark.csv";
+
+    const u32 max_workers = cpp::job_system::default_workers_count();
+
+    std::string report = "workers,best_ms\n";
+    for (u32 workers = 0;; workers = std::min(workers * 2 + 1, max_workers))
+    {
+        cpp::job_system jobs(workers);
+
+        f64 best_ms = std::numeric_limits<f64>::max();
+        for (u32 load = 0; load <= kTimedLoads; ++load)
+        {
+            const u64 start = SDL_GetPerformanceCounter();
+            for (u32 i = 0; i < models_count; ++i)
+            {
+                for (const static_model& loaded : *static_model::load(models[i], geometry_pool, jobs))
+                {
+                    static_model::unload(loaded, geometry_pool);
+                }
+            }
+
+            const f64 ms = static_cast<f64>(SDL_GetPerformanceCounter() - start) * 1000.0
+                         / static_cast<f64>(SDL_GetPerformanceFrequency());
+            if (load > 0)
+            {
+                best_ms = std::min(best_ms, ms);
+            }
+        }
+
+        report += cpp::stack_string::make_formatted("%u,%.3lf\n", workers, best_ms).c_str();
+        if (workers == max_workers)
+        {
+            break;
+        }
+    }
+
+    fs::write_file(kLoaderBenchmarkRecordPath, bytes(report.size(), report.data()));
+}
+
+u64 scene_triangles(const render::model_registry& scene_models, scene& scene)
+{
+    ZoneScoped;
+
+    u64 triangles = 0;
+    for (const auto& [entity, smc] : scene.get_view<static_model_component>().each())
+    {
+        triangles += scene_models.get(smc.handle).lod_array[0].indices_count / 3;
+    }
+
+    return triangles;
+}
+
+// debug motion for the incremental transform upload, the first instances spin around their origin
+void spin_instances(scene& scene, const u32 count, const f32 dt)
+{
+    ZoneScoped;
+
+    const glm::quat spin = glm::angleAxis(dt, vec3(0.0F, 1.0F, 0.0F));
+
+    u32 spun    = 0;
+    auto&& view = scene.get_view<transform_component, gpu_instance_component>();
+    for (auto it = view.begin(); it != view.end() && spun < count; ++it, ++spun)
+    {
+        scene.patch_component<transform_component>(*it,
+                                                   [&](transform_component& tc)
+                                                   {
+                                                       tc.rotation = spin * tc.rotation;
+                                                   });
+    }
+}
+
+// debug churn for the slot allocator, the first instances are destroyed and spawned again as new entities
+void respawn_instances(scene& scene, const u32 count)
+{
+    ZoneScoped;
+
+    std::vector<entt::entity> destroyed;
+    std::vector<transform_component> transforms;
+    std::vector<static_model_component> model_components;
+
+    auto&& view = scene.get_view<transform_component, static_model_component, gpu_instance_component>();
+    for (auto it = view.begin(); it != view.end() && destroyed.size() < count; ++it)
+    {
+        destroyed.push_back(*it);
+        transforms.push_back(view.get<transform_component>(*it));
+        model_components.push_back(view.get<static_model_component>(*it));
+    }
+
+    scene.delete_entities(destroyed);
+
+    const std::vector<id_component> ids(destroyed.size());
+    scene.create_entities<static_model_component, id_component, transform_component>(
+        destroyed.size(), model_components, ids, transforms);
 }
 
-void upload_draw_data(const render::vk_buffer_transfer& transfer, const render::vk_buffer& transform_buffer,
-                      const render::vk_buffer& mesh_data_buffer, const scene& scene)
+instanced_draw_data create_instanced_draw_data(const render::vk_renderer& renderer,
+                                               const render::vk_buffer_transfer& transfer,
+                                               const render::model_registry& scene_models, const u32 geometry_count)
 {
     ZoneScoped;
 
-    auto&& view              = scene.get_view<transform_component, static_model_component>();
-    const u64 view_size_hint = view.size_hint();
+    constexpr u32 kLODCount = static_model::kLODCount;
+
+    std::vector<u32> geometry_instances(geometry_count, 0);
+    std::vector<const static_model*> geometry_models(geometry_count, nullptr);
 
-    auto* transforms    = static_cast<transform_component*>(transfer.mapped);
-    auto* static_models = reinterpret_cast<static_model*>(static_cast<u8*>(transfer.mapped)
-                                                          + sizeof(transform_component) * view_size_hint);
+    // the references of a model are the instances in the scene, the ones waiting for a slot included
+    for (const auto& record : scene_models.records)
+    {
+        if (record.loaded && record.references > 0)
+        {
+            geometry_instances[record.model.geometry_id] += record.references;
+            geometry_models[record.model.geometry_id] = &record.model;
+        }
+    }
+
+    // every lod bin of a geometry may receive all of its instances, so reserve that many ids per bin, with headroom
+    // for the spawned ones
+    // each (geometry, lod) has a u32 and a u16 bin next to each other, only the one matching the lod indices is used
+    u32 instances_total = 0;
+    std::vector<draw_indexed_indirect> bins(geometry_count * kLODCount * 2, draw_indexed_indirect {});
+    std::vector<u32> geometry_capacity(geometry_count, 0);
+    for (u32 g = 0; g < geometry_count; ++g)
+    {
+        const static_model* model = geometry_models[g];
+        if (model)
+        {
+            geometry_capacity[g] =
+                static_cast<u32>(render::grow_capacity(geometry_instances[g], geometry_instances[g] + 1));
+        }
 
-    u32 index = 0;
-    view.each(
-        [&](const transform_component& tc, const static_model_component& smc)
+        for (u32 l = 0; model && l < model->lod_count; ++l)
         {
-            transforms[index]    = tc;
-            static_models[index] = smc.model;
+            auto& bin          = bins[(g * kLODCount + l) * 2 + model->lod_array[l].short_indices];
+            bin.index_count    = model->lod_array[l].indices_count;
+            bin.first_index    = model->lod_array[l].base_index;
+            bin.vertex_offset  = static_cast<i32>(model->base_vertex + model->lod_array[l].base_vertex);
+            bin.first_instance = instances_total;
+            bin.mesh_id        = g;
+
+            instances_total += geometry_capacity[g];
+        }
+    }
+
+    instanced_draw_data result {
+        .bins_count        = static_cast<u32>(bins.size()),
+        .geometry_capacity = std::move(geometry_capacity),
+    };
+
+    const u64 bins_size = std::max<u64>(bins.size() * sizeof(draw_indexed_indirect), sizeof(draw_indexed_indirect));
+
+    result.bins = *render::create_buffer(
+        bins_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+    result.bins_template = *render::create_buffer(bins_size,
+                                                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                  renderer.get_context().allocator,
+                                                  0);
+    result.instance_ids =
+        *render::create_buffer(std::max<u64>(instances_total * sizeof(u32), sizeof(u32)),
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               renderer.get_context().allocator,
+                               0);
+
+    if (!bins.empty())
+    {
+        render::upload_data(transfer, result.bins_template, bins.data(), bins.size());
+    }
+
+    return result;
+}
+
+void destroy_instanced_draw_data(const render::vk_renderer& renderer, instanced_draw_data& instanced_data)
+{
+    render::destroy_buffer(renderer.get_context().allocator, instanced_data.bins);
+    render::destroy_buffer(renderer.get_context().allocator, instanced_data.bins_template);
+    render::destroy_buffer(renderer.get_context().allocator, instanced_data.instance_ids);
+    instanced_data.bins_count = 0;
+}
+
+// patches the cpu copies of the moved models: the registry records and the instanced bins built from them
+void relocate_scene_geometry(const render::vk_renderer& renderer, const render::vk_scene_geometry_pool& geometry_pool,
+                             const std::vector<render::vk_geometry_relocation>& relocations,
+                             render::model_registry& scene_models, instanced_draw_data& instanced_data)
+{
+    ZoneScoped;
+
+    scene_models.relocate(relocations);
+
+    destroy_instanced_draw_data(renderer, instanced_data);
+    instanced_data =
+        create_instanced_draw_data(renderer, geometry_pool.transfer, scene_models, geometry_pool.geometry_count);
+}
+
+// Compacts the geometry pool and patches every copy of the moved models, the meshes table on the gpu included.
+// Stalls the device. Nothing moves on failure.
+result<bool> defragment_geometry(const render::vk_renderer& renderer, render::vk_scene_geometry_pool& geometry_pool,
+                                 const render::vk_pipeline& relocate_meshes,
+                                 const render::vk_pipeline& relocate_meshlets, const render::vk_buffer& meshes_data,
+                                 const u32 meshes_count, render::model_registry& scene_models,
+                                 instanced_draw_data& instanced_data)
+{
+    ZoneScoped;
+
+    const auto relocations = render::defragment_geometry_pool(
+        renderer, geometry_pool, relocate_meshes, relocate_meshlets, meshes_data, meshes_count);
+    if (!relocations)
+    {
+        return relocations.message;
+    }
 
-            ++index;
-        });
+    relocate_scene_geometry(renderer, geometry_pool, *relocations, scene_models, instanced_data);
+    return true;
+}
+
+// Uploads the geometry representation of the draw path switched to and releases the other one, patching every copy
+// of the models like the defragmentation does. Stalls the device. The pool keeps its representation on failure.
+result<bool> switch_geometry_residency(const render::vk_renderer& renderer,
+                                       render::vk_scene_geometry_pool& geometry_pool,
+                                       const render::geometry_residency residency,
+                                       const render::vk_pipeline& relocate_meshes, const render::vk_buffer& meshes_data,
+                                       const u32 meshes_count, render::model_registry& scene_models,
+                                       instanced_draw_data& instanced_data)
+{
+    ZoneScoped;
 
-    render::submit_transfer(transfer, transform_buffer, VkBufferCopy {.size = index * sizeof(transform_component)});
-    render::submit_transfer(
-        transfer,
-        mesh_data_buffer,
-        VkBufferCopy {.srcOffset = sizeof(transform_component) * view_size_hint, .size = index * sizeof(static_model)});
+    const auto relocations =
+        render::set_geometry_residency(renderer, geometry_pool, residency, relocate_meshes, meshes_data, meshes_count);
+    if (!relocations)
+    {
+        return relocations.message;
+    }
+
+    relocate_scene_geometry(renderer, geometry_pool, *relocations, scene_models, instanced_data);
+    return true;
 }
 
 int main(int argc, char* argv[])
 {
-    srand(322);
+#if MESHLET_BENCHMARK
+    u32 meshlet_config = render::kMeshletConfigsCount;
+    for (i32 i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--meshlet-config")
+        {
+            meshlet_config = static_cast<u32>(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+    }
+
+    // without a config to measure, sweep them all, each one in a fresh process so that no state leaks between runs
+    if (meshlet_config >= render::kMeshletConfigsCount)
+    {
+        for (u32 i = 0; i < render::kMeshletConfigsCount; ++i)
+        {
+            const auto command = cpp::big_stack_string::make_formatted("\"%s\" --meshlet-config %u", argv[0], i);
+            std::system(command.c_str());
+        }
+
+        return 0;
+    }
+#endif
+
+    constexpr u32 kRandomSeed = 322;
+    srand(kRandomSeed);
     TracySetProgramName("gdr");
 
+    // the asset processing temporaries are reused across meshes instead of hitting the heap on every call
+    render::set_meshopt_scratch_allocator();
+
     window client_window("VK window", {1920, 960}, false);
     debug::assert2_set_window(client_window.get_native_handle().window);
 
@@ -467,6 +949,19 @@ int main(int argc, char* argv[])
     bool pipeline_stats_supported =
         renderer.get_context().enabled_device_features.supported(render::rendering_features_table::ePipelineStats);
 
+    VkPhysicalDeviceProperties device_properties = {};
+    vkGetPhysicalDeviceProperties(renderer.get_context().physical_device, &device_properties);
+
+#if MESHLET_BENCHMARK
+    if (!mesh_shading_supported)
+    {
+        return 1;
+    }
+#else
+    const u32 meshlet_config = render::load_meshlet_config_index(
+        render::kMeshletBenchmarkRecordPath, device_properties.vendorID, device_properties.deviceID);
+#endif
+
     client_events.add_watcher(
         event_type::request_close,
         [](auto&, void* user_data)
@@ -526,23 +1021,103 @@ int main(int argc, char* argv[])
     const auto indexed_render_pipeline =
         *render::vk_pipeline::create_graphics(renderer, indexed_shaders, COUNT_OF(indexed_shaders));
 
+    // shades the second phase over depth-only occluders, equal depth lets the occluders pass again
+    const auto indexed_redraw_pipeline = *render::vk_pipeline::create_graphics(renderer,
+                                                                               indexed_shaders,
+                                                                               COUNT_OF(indexed_shaders),
+                                                                               VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                                                               VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+    // no fragment stage, only the position stream is fetched
+    render::vk_shader indexed_depth_shaders[] = {
+        *render::vk_shader::load(renderer, "../shaders/bin/mesh_depth.vert.spv"),
+    };
+
+    const auto indexed_depth_pipeline =
+        *render::vk_pipeline::create_graphics(renderer, indexed_depth_shaders, COUNT_OF(indexed_depth_shaders));
+
     const auto indexed_cull_pipeline = *render::vk_pipeline::create_compute(
         renderer, *render::vk_shader::load(renderer, "../shaders/bin/cull_mesh.comp.spv"));
 
     const auto indexed_cull_occlusion_pipeline = *render::vk_pipeline::create_compute(
         renderer, *render::vk_shader::load(renderer, "../shaders/bin/cull_occlusion_mesh.comp.spv"));
 
+    render::vk_shader instanced_shaders[] = {
+        *render::vk_shader::load(renderer, "../shaders/bin/mesh_instanced.vert.spv"),
+        *render::vk_shader::load(renderer, "../shaders/bin/meshlets.frag.spv"),
+    };
+
+    const auto instanced_render_pipeline =
+        *render::vk_pipeline::create_graphics(renderer, instanced_shaders, COUNT_OF(instanced_shaders));
+
+    const auto instanced_redraw_pipeline = *render::vk_pipeline::create_graphics(renderer,
+                                                                                 instanced_shaders,
+                                                                                 COUNT_OF(instanced_shaders),
+                                                                                 VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                                                                 VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+    render::vk_shader instanced_depth_shaders[] = {
+        *render::vk_shader::load(renderer, "../shaders/bin/mesh_instanced_depth.vert.spv"),
+    };
+
+    const auto instanced_depth_pipeline =
+        *render::vk_pipeline::create_graphics(renderer, instanced_depth_shaders, COUNT_OF(instanced_depth_shaders));
+
+    const auto instanced_cull_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/cull_instanced.comp.spv"));
+
+    const auto instanced_cull_occlusion_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/cull_occlusion_instanced.comp.spv"));
+
+    const auto indexed_sort_keys_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/draw_sort_keys_mesh.comp.spv"));
+
+    const auto indexed_sort_reorder_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/draw_sort_reorder_mesh.comp.spv"));
+
+    const auto cluster_cull_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/cluster_cull.comp.spv"));
+
     const auto depth_reduce_pipeline = *render::vk_pipeline::create_compute(
         renderer, *render::vk_shader::load(renderer, "../shaders/bin/depth_reduce.comp.spv"));
 
+    render::vk_shader impostor_shaders[] = {
+        *render::vk_shader::load(renderer, "../shaders/bin/impostor.vert.spv"),
+        *render::vk_shader::load(renderer, "../shaders/bin/impostor.frag.spv"),
+    };
+
+    const auto impostor_pipeline =
+        *render::vk_pipeline::create_graphics(renderer, impostor_shaders, COUNT_OF(impostor_shaders));
+
+    render::vk_shader impostor_bake_shaders[] = {
+        *render::vk_shader::load(renderer, "../shaders/bin/impostor_bake.vert.spv"),
+        *render::vk_shader::load(renderer, "../shaders/bin/impostor_bake.frag.spv"),
+    };
+
+    const auto impostor_bake_pipeline =
+        *render::vk_pipeline::create_graphics(renderer, impostor_bake_shaders, COUNT_OF(impostor_bake_shaders));
+
+    const auto transform_scatter_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/transform_scatter.comp.spv"));
+    const auto instance_scatter_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/instance_scatter.comp.spv"));
+
+    const auto geometry_relocate_meshes_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/geometry_relocate_meshes.comp.spv"));
+
+    const auto geometry_relocate_meshlets_pipeline = *render::vk_pipeline::create_compute(
+        renderer, *render::vk_shader::load(renderer, "../shaders/bin/geometry_relocate_meshlets.comp.spv"));
+
     render::vk_pipeline meshlets_cull_pipeline;
     render::vk_pipeline meshlets_render_pipeline;
     render::vk_pipeline meshlets_occlusion_cull_pipeline;
+    render::vk_pipeline meshlets_sort_keys_pipeline;
+    render::vk_pipeline meshlets_sort_reorder_pipeline;
     if (mesh_shading_supported)
     {
         render::vk_shader meshlets_shaders[] = {
-            *render::vk_shader::load(renderer, "../shaders/bin/meshlets.task.spv"),
-            *render::vk_shader::load(renderer, "../shaders/bin/meshlets.mesh.spv"),
+            *render::vk_shader::load(renderer, render::meshlet_shader_path(meshlet_config, "meshlets", "task")),
+            *render::vk_shader::load(renderer, render::meshlet_shader_path(meshlet_config, "meshlets", "mesh")),
             *render::vk_shader::load(renderer, "../shaders/bin/meshlets.frag.spv"),
         };
 
@@ -550,10 +1125,19 @@ int main(int argc, char* argv[])
             *render::vk_pipeline::create_graphics(renderer, meshlets_shaders, COUNT_OF(meshlets_shaders));
 
         meshlets_cull_pipeline = *render::vk_pipeline::create_compute(
-            renderer, *render::vk_shader::load(renderer, "../shaders/bin/cull_meshlets.comp.spv"));
+            renderer,
+            *render::vk_shader::load(renderer, render::meshlet_shader_path(meshlet_config, "cull_meshlets", "comp")));
 
         meshlets_occlusion_cull_pipeline = *render::vk_pipeline::create_compute(
-            renderer, *render::vk_shader::load(renderer, "../shaders/bin/cull_occlusion_meshlets.comp.spv"));
+            renderer,
+            *render::vk_shader::load(renderer,
+                                     render::meshlet_shader_path(meshlet_config, "cull_occlusion_meshlets", "comp")));
+
+        meshlets_sort_keys_pipeline = *render::vk_pipeline::create_compute(
+            renderer, *render::vk_shader::load(renderer, "../shaders/bin/draw_sort_keys_meshlets.comp.spv"));
+
+        meshlets_sort_reorder_pipeline = *render::vk_pipeline::create_compute(
+            renderer, *render::vk_shader::load(renderer, "../shaders/bin/draw_sort_reorder_meshlets.comp.spv"));
     }
 
 #if !NO_EDITOR
@@ -579,19 +1163,26 @@ int main(int argc, char* argv[])
     });
 
     render::vk_scene_geometry_pool geometry_pool {
-        .index    = render::vk_shared_buffer(renderer, 128 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT),
-        .vertex   = render::vk_shared_buffer(renderer, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT),
-        .transfer = *render::create_buffer_transfer(renderer.get_context().device,
-                                                    renderer.get_context().allocator,
-                                                    renderer.get_context().queues[render::queue_kind::eTransfer],
-                                                    128 * 1024 * 1024)};
-
+        .index     = render::vk_shared_buffer(renderer, 16 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT),
+        .index16   = render::vk_shared_buffer(renderer, 8 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT),
+        .position  = render::vk_shared_buffer(renderer, 24 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT),
+        .attribute = render::vk_shared_buffer(renderer, 8 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT),
+        .transfer  = *render::create_buffer_transfer(renderer.get_context().device,
+                                                     renderer.get_context().allocator,
+                                                     renderer.get_context().queues[render::queue_kind::eTransfer],
+                                                     32 * 1024 * 1024)};
+
+    // the pools start small and grow with the loaded geometry, the position and attribute pools keep their 3:1
+    // proportion as they grow. Only the representation of the initial draw path is uploaded
+    geometry_pool.meshlet_config_index = meshlet_config;
+    geometry_pool.compact_lod_vertices = true;
     if (mesh_shading_supported)
     {
+        geometry_pool.residency = render::geometry_residency::meshlets;
         geometry_pool.meshlets =
-            render::vk_shared_buffer(renderer, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+            render::vk_shared_buffer(renderer, 16 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
         geometry_pool.meshlets_payload =
-            render::vk_shared_buffer(renderer, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+            render::vk_shared_buffer(renderer, 16 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     }
 
     constexpr u32 kQueryPoolCount = 64;
@@ -611,73 +1202,269 @@ int main(int argc, char* argv[])
                 | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT);
     }
 
-    render::vk_buffer draw_count_buffer = *render::create_buffer(
-        sizeof(u32),
-        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        renderer.get_context().allocator,
-        0);
+    render::vk_mapped_buffer frame_cull_data_buffers[3];
+    for (u32 i = 0; i < 3; i++)
+    {
+        frame_cull_data_buffers[i] =
+            *render::create_buffer_mapped(sizeof(frame_cull_data),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          renderer.get_context().allocator,
+                                          VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+    }
 
-    render::vk_buffer mesh_visibility_buffer = *render::create_buffer(
-        32 * 1024 * 1024,
-        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        renderer.get_context().allocator,
-        0);
+    gpu_profile_data profile_data;
+    // settings of the last run, written back on exit through the generated serialization
+    constexpr const char* kRenderSettingsFile = ".settings_cache/render_settings.bin";
+    render_settings client_render_settings;
+    if (const auto saved = fs::read_file(kRenderSettingsFile))
+    {
+        codegen::binary_reader reader {.data = saved->get<u8>(), .size = saved->size()};
+        if (!codegen::read(client_render_settings, reader))
+        {
+            client_render_settings = {};
+        }
+    }
 
-    render::fill_buffer(geometry_pool.transfer, mesh_visibility_buffer, 0);
+    glm::mat4 camera_proj_view;
 
-    render::vk_buffer meshes_data =
-        *render::create_buffer(32 * 1024 * 1024,
-                               VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                               renderer.get_context().allocator,
-                               0);
+    // triangle cull costs mesh shader time for a gain that depends on the scene, it is opted in from the editor
+    u32 flags                     = 0xFFFF & ~(1u << shader_constants::kTriangleCullBit);
+    bool freeze_cull_data         = false;
+    bool enable_meshlets_pipeline = mesh_shading_supported;
+    bool enable_instanced_draws   = false;
+    bool enable_draw_sort         = false;
 
-    render::vk_buffer meshes_transforms =
-        *render::create_buffer(16 * 1024 * 1024,
-                               VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                               renderer.get_context().allocator,
-                               0);
+    // draw last frame occluders depth-only and shade every visible object in the second phase
+    bool enable_depth_only_occluders = false;
+
+    // instances covering a few pixels are drawn as a quad of their octahedral impostor
+    bool enable_impostors = false;
+
+    // the per-invocation atomicAdd the cull passes appended draws with before the scan, to compare both
+    bool enable_atomic_compaction = false;
+
+    // instances passing the sphere frustum test also test their oriented box
+    bool enable_box_cull = true;
+
+    // first instances spun every frame, their transforms go through the incremental upload
+    i32 spinning_instances = 0;
+
+    // first instances destroyed and spawned again every frame, their slots go through the slot allocator
+    i32 respawned_instances = 0;
+
+    // handled between frames, as it stalls the device
+    bool defragment_geometry_requested = false;
+    bool unload_models_requested       = false;
+
+    // of the last residency switch or defragmentation that failed, the pool is left as it was
+    const char* geometry_pool_error = "";
+
+    // of the last per-instance tables growth that failed, the spawned instances wait for a slot meanwhile
+    const char* instance_capacity_error = "";
+
+    // to show what the sort saves in fragment invocations and the box test in visible instances, one at a time
+    frame_comparison sort_comparison;
+    frame_comparison box_cull_comparison;
+    u32 visible_instances = 0;
+
+#if MESHLET_BENCHMARK
+    u32 benchmark_frames      = 0;
+    f64 benchmark_gpu_time_ms   = 0.0;
+#endif
+
+#if TEST_MULTI_OBJECTS
+    constexpr u32 kRepeatDraws = 3'375;
+    const char* models[]       = {"../data/kitten.obj", "../data/backpack/backpack.obj"};
+    const char* scene_name     = "multi_objects";
+#else
+    constexpr u32 kRepeatDraws = 125'000;
+    const char* models[]       = {"../data/kitten.obj"};
+    const char* scene_name     = "kittens";
+#endif
+
+    const fs::path scene_file = baked_scene_path(scene_name, kRepeatDraws, kRandomSeed, models, COUNT_OF(models));
+
+    // the scaling of the model loading with the number of job workers, see benchmark_model_loading
+    for (i32 i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--loader-benchmark")
+        {
+            benchmark_model_loading(models, COUNT_OF(models), geometry_pool);
+            return 0;
+        }
+    }
+
+    // asset processing runs on the workers, the main thread runs jobs as well while it waits for them
+    cpp::job_system jobs;
+
+    // instances reference their model by a handle, the registry counts them through the component signals
+    render::model_registry scene_models;
+    client_scene.on_construct<static_model_component>().connect<&acquire_model>(scene_models);
+    client_scene.on_destroy<static_model_component>().connect<&release_model>(scene_models);
+
+    // the procedural scene is baked on the first run and loaded from the file afterwards
+    if (!load_scene(scene_file, client_scene, scene_models, geometry_pool, jobs))
+    {
+        populate_scene(kRepeatDraws, models, COUNT_OF(models), client_scene, geometry_pool, scene_models, jobs);
+        if (const auto baked = serialize_scene(client_scene, scene_models))
+        {
+            fs::write_file(scene_file, *baked);
+        }
+    }
+
+    u64 scene_triangles_max = scene_triangles(scene_models, client_scene);
+    const auto instances_count = static_cast<u32>(client_scene.get_view<static_model_component>().size());
+
+    // the per-instance tables start with some headroom and grow with the instances, see reserve_instance_capacity
+    const auto instances_capacity = static_cast<u32>(
+        render::grow_capacity(instances_count, instances_count + shader_constants::kCullWorkGroupSize));
+
+    render::instance_slots_data instance_slots(instances_capacity);
+    client_scene.on_destroy<gpu_instance_component>().connect<&render::instance_slots_data::on_destroy>(
+        instance_slots);
+
+    // per-instance buffers keep the transfer usages to grow with reserve_buffer, see reserve_instance_capacity
+    constexpr VkBufferUsageFlags kGrowableUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    render::vk_buffer mesh_visibility_buffer = *render::create_buffer(
+        (instances_capacity + 31) / 32 * sizeof(u32),
+        kGrowableUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+
+    render::fill_buffer(geometry_pool.transfer, mesh_visibility_buffer, 0);
+
+    render::vk_buffer meshes_data = *render::create_buffer(instances_capacity * sizeof(static_model),
+                                                           kGrowableUsage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                           renderer.get_context().allocator,
+                                                           0);
+
+    render::vk_buffer meshes_transforms = *render::create_buffer(instances_capacity * sizeof(transform_component),
+                                                                 kGrowableUsage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                                 renderer.get_context().allocator,
+                                                                 0);
 
     render::vk_buffer indexed_draw_indirect_buffer = *render::create_buffer(
-        16 * 1024 * 1024,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        instances_capacity * sizeof(draw_indexed_indirect),
+        kGrowableUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+
+    render::vk_buffer indexed16_draw_indirect_buffer = *render::create_buffer(
+        instances_capacity * sizeof(draw_indexed_indirect),
+        kGrowableUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         renderer.get_context().allocator,
         0);
 
     render::vk_buffer meshlets_draw_indirect_buffer = *render::create_buffer(
-        16 * 1024 * 1024,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        instances_capacity * sizeof(draw_task_indirect_cmd),
+        kGrowableUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         renderer.get_context().allocator,
         0);
 
-    render::vk_mapped_buffer frame_cull_data_buffers[3];
+    // draw count followed by the cull scan tile counter and one look-back state per cull workgroup and draw stream,
+    // the indexed path compacts u32 and u16 lods into two streams
+    const u32 cull_tiles_count =
+        (instances_capacity + shader_constants::kCullWorkGroupSize - 1) / shader_constants::kCullWorkGroupSize;
+    render::vk_buffer draw_count_buffer = *render::create_buffer(
+        sizeof(u32) * (2 + 2 * cull_tiles_count),
+        kGrowableUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+
+    // draw count of the u16 stream, kept apart as the sort passes read their count from the start of the buffer
+    render::vk_buffer draw_count_buffer_16 = *render::create_buffer(
+        sizeof(u32),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+
+    render::instance_clusters_data clusters_data = render::create_instance_clusters_data(renderer, instances_capacity);
+    render::upload_draw_data(geometry_pool.transfer,
+                             meshes_transforms,
+                             meshes_data,
+                             clusters_data,
+                             instance_slots,
+                             scene_models,
+                             client_scene);
+
+    // per frame in flight, grown when more instances move or spawn in a frame
+    render::vk_mapped_buffer transform_updates_buffers[3];
+    render::vk_mapped_buffer instance_updates_buffers[3];
     for (u32 i = 0; i < 3; i++)
     {
-        frame_cull_data_buffers[i] =
-            *render::create_buffer_mapped(sizeof(frame_cull_data),
+        transform_updates_buffers[i] =
+            *render::create_buffer_mapped(1024 * sizeof(render::transform_update),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          renderer.get_context().allocator,
+                                          VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        instance_updates_buffers[i] =
+            *render::create_buffer_mapped(1024 * (sizeof(render::transform_update) + sizeof(static_model)),
                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                                           renderer.get_context().allocator,
                                           VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
     }
 
-    gpu_profile_data profile_data;
-    render_settings client_render_settings;
+    instanced_draw_data instanced_data =
+        create_instanced_draw_data(renderer, geometry_pool.transfer, scene_models, geometry_pool.geometry_count);
+    render::draw_sort_data draw_sort = render::create_draw_sort_data(
+        renderer,
+        instances_capacity,
+        static_cast<u32>(std::max(sizeof(draw_indexed_indirect), sizeof(draw_task_indirect_cmd))));
 
-    glm::mat4 camera_proj_view;
+    render::impostor_draw_data impostors = render::create_impostor_draw_data(
+        renderer, geometry_pool, impostor_bake_pipeline, scene_models, instances_capacity);
 
-    u32 flags                     = 0xFFFF;
-    bool freeze_cull_data         = false;
-    bool enable_meshlets_pipeline = mesh_shading_supported;
+    // Grows every per-instance table to hold required_slots instances, the slots keep their index. Stalls the device,
+    // the buffers are bound by the frames from the variables, so the reallocated ones are picked up by the next frame.
+    // The allocator only grows once all the buffers did, a failure leaves the spawned instances waiting for a slot
+    auto reserve_instance_capacity = [&](const u32 required_slots) -> result<bool>
+    {
+        ZoneScopedN("reserve_instance_capacity");
 
-#if TEST_MULTI_OBJECTS
-    constexpr u32 kRepeatDraws = 3'375;
-    const char* models[]       = {"../data/kitten.obj", "../data/backpack/backpack.obj"};
-#else
-    constexpr u32 kRepeatDraws = 125'000;
-    const char* models[]       = {"../data/kitten.obj"};
-#endif
+        const u32 old_capacity = instance_slots.allocator.capacity;
+        if (required_slots <= old_capacity)
+        {
+            return false;
+        }
+
+        const auto capacity = static_cast<u32>(render::grow_capacity(old_capacity, required_slots));
+        const u32 tiles_count =
+            (capacity + shader_constants::kCullWorkGroupSize - 1) / shader_constants::kCullWorkGroupSize;
+
+        vkDeviceWaitIdle(renderer.get_context().device);
+
+        const std::pair<render::vk_buffer*, u64> growable_buffers[] = {
+            {&mesh_visibility_buffer, (capacity + 31) / 32 * sizeof(u32)},
+            {&meshes_data, capacity * sizeof(static_model)},
+            {&meshes_transforms, capacity * sizeof(transform_component)},
+            {&indexed_draw_indirect_buffer, capacity * sizeof(draw_indexed_indirect)},
+            {&indexed16_draw_indirect_buffer, capacity * sizeof(draw_indexed_indirect)},
+            {&meshlets_draw_indirect_buffer, capacity * sizeof(draw_task_indirect_cmd)},
+            {&draw_count_buffer, sizeof(u32) * (2 + 2 * tiles_count)},
+        };
+
+        for (const auto& [buffer, size] : growable_buffers)
+        {
+            if (auto reserved = render::reserve_buffer(geometry_pool.transfer, *buffer, size); !reserved)
+            {
+                return reserved.message;
+            }
+        }
 
-    u64 scene_triangles_max = populate_scene(kRepeatDraws, models, COUNT_OF(models), client_scene, geometry_pool);
-    upload_draw_data(geometry_pool.transfer, meshes_transforms, meshes_data, client_scene);
+        // the cluster and sort buffers are rebuilt every frame, only the host clusters are uploaded again
+        render::grow_instance_clusters(renderer, geometry_pool.transfer, clusters_data, capacity);
+
+        render::destroy_draw_sort_buffers(renderer, draw_sort);
+        render::create_draw_sort_buffers(renderer, draw_sort, capacity);
+
+        render::destroy_buffer(renderer.get_context().allocator, impostors.instance_ids);
+        impostors.instance_ids = *render::create_buffer(
+            capacity * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, renderer.get_context().allocator, 0);
+
+        instance_slots.grow(capacity);
+        return true;
+    };
 
     auto get_time = []<typename T = f64>()
     {
@@ -702,13 +1489,99 @@ int main(int argc, char* argv[])
 
         auto& camera_transform = camera.get_component<transform_component>();
         auto& camera_data      = camera.get_component<camera_component>();
-        controller.update(camera_transform, camera_data, static_cast<f32>(dt));
+
+        // both options are compared from the same view
+        if (!sort_comparison.running && !box_cull_comparison.running)
+        {
+            controller.update(camera_transform, camera_data, static_cast<f32>(dt));
+        }
+
+        if (spinning_instances > 0)
+        {
+            spin_instances(client_scene, static_cast<u32>(spinning_instances), static_cast<f32>(dt));
+        }
+
+        // the representation of the other draw path is uploaded lazily, once it gets enabled
+        const auto residency =
+            enable_meshlets_pipeline ? render::geometry_residency::meshlets : render::geometry_residency::indexed;
+        if (geometry_pool.residency != residency)
+        {
+            const auto switched = switch_geometry_residency(renderer,
+                                                            geometry_pool,
+                                                            residency,
+                                                            geometry_relocate_meshes_pipeline,
+                                                            meshes_data,
+                                                            instance_slots.allocator.slots_end,
+                                                            scene_models,
+                                                            instanced_data);
+            if (!switched)
+            {
+                // stay on the draw path the resident representation serves
+                enable_meshlets_pipeline = geometry_pool.residency == render::geometry_residency::meshlets;
+                geometry_pool_error      = switched.message;
+            }
+        }
+
+        if (defragment_geometry_requested)
+        {
+            defragment_geometry_requested = false;
+
+            const auto defragmented = defragment_geometry(renderer,
+                                                          geometry_pool,
+                                                          geometry_relocate_meshes_pipeline,
+                                                          geometry_relocate_meshlets_pipeline,
+                                                          meshes_data,
+                                                          instance_slots.allocator.slots_end,
+                                                          scene_models,
+                                                          instanced_data);
+            if (!defragmented)
+            {
+                geometry_pool_error = defragmented.message;
+            }
+        }
+
+        if (respawned_instances > 0)
+        {
+            respawn_instances(client_scene, static_cast<u32>(respawned_instances));
+        }
 
         if (!renderer.acquire_frame())
         {
             return;
         }
 
+        if (auto reserved = reserve_instance_capacity(instance_slots.required_slots(client_scene)); !reserved)
+        {
+            instance_capacity_error = reserved.message;
+        }
+
+        // the queued slot updates are uploaded by this frame, the instanced bins are rebuilt once a geometry outgrows
+        // the ids they reserve
+        if (render::sync_instance_slots(geometry_pool,
+                                        instance_slots,
+                                        clusters_data,
+                                        instanced_data.geometry_capacity,
+                                        scene_models,
+                                        client_scene))
+        {
+            // frames in flight may still draw from the bins
+            vkDeviceWaitIdle(renderer.get_context().device);
+
+            destroy_instanced_draw_data(renderer, instanced_data);
+            instanced_data = create_instanced_draw_data(
+                renderer, geometry_pool.transfer, scene_models, geometry_pool.geometry_count);
+        }
+
+        // the entities of the unloaded models are gone and the sync above queued their slots to be emptied, which
+        // this frame uploads before any pass reads the tables
+        if (unload_models_requested)
+        {
+            unload_models_requested = false;
+
+            vkDeviceWaitIdle(renderer.get_context().device);
+            scene_models.unload_unreferenced(geometry_pool);
+        }
+
         renderer.submit(
             [&](VkCommandBuffer buffer)
             {
@@ -730,6 +1603,23 @@ int main(int argc, char* argv[])
 
                 vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_query_pool, 0);
 
+                // the meshlets path has no depth-only pipeline
+                const bool use_depth_only_occluders = enable_depth_only_occluders && !enable_meshlets_pipeline;
+
+                constexpr u32 kDepthOnlyOccludersMask = 1u << shader_constants::kDepthOnlyOccludersBit;
+                constexpr u32 kImpostorsMask          = 1u << shader_constants::kImpostorsBit;
+                constexpr u32 kAtomicCompactionMask   = 1u << shader_constants::kAtomicCompactionBit;
+                constexpr u32 kBoxCullMask            = 1u << shader_constants::kBoxCullBit;
+
+                const bool use_box_cull =
+                    box_cull_comparison.running ? box_cull_comparison.enabled_frame() : enable_box_cull;
+
+                const u32 frame_flags =
+                    (flags & ~(kDepthOnlyOccludersMask | kImpostorsMask | kAtomicCompactionMask | kBoxCullMask))
+                    | (use_depth_only_occluders ? kDepthOnlyOccludersMask : 0u)
+                    | (enable_impostors ? kImpostorsMask : 0u) | (enable_atomic_compaction ? kAtomicCompactionMask : 0u)
+                    | (use_box_cull ? kBoxCullMask : 0u);
+
                 auto& frame_cull_data_buffer = frame_cull_data_buffers[renderer.get_frame_index()];
                 if (!freeze_cull_data)
                 {
@@ -740,37 +1630,219 @@ int main(int argc, char* argv[])
                     auto view = camera_data.get_view_matrix(camera_transform.position, camera_transform.rotation);
 
                     (*static_cast<frame_cull_data*>(frame_cull_data_buffer.mapped)) =
-                        frame_cull_data {
-                            .pyramid_size = depth_pyramid.base_size, .draw_count = kRepeatDraws, .flags = flags}
+                        frame_cull_data {.pyramid_size  = depth_pyramid.base_size,
+                                         .viewport_size = vec2(viewport.width, viewport.height),
+                                         .draw_count    = instance_slots.allocator.slots_end,
+                                         .flags         = frame_flags}
                             .build_frustum(projection, view);
                 }
                 else
                 {
-                    static_cast<frame_cull_data*>(frame_cull_data_buffer.mapped)->flags = flags;
+                    static_cast<frame_cull_data*>(frame_cull_data_buffer.mapped)->draw_count =
+                        instance_slots.allocator.slots_end;
+                    static_cast<frame_cull_data*>(frame_cull_data_buffer.mapped)->flags = frame_flags;
+                    static_cast<frame_cull_data*>(frame_cull_data_buffer.mapped)->visible_instances = 0;
                 }
 
                 camera_proj_view = camera_data.get_projection_matrix()
                                  * camera_data.get_view_matrix(camera_transform.position, camera_transform.rotation);
 
+                const bool use_instancing = enable_instanced_draws && !enable_meshlets_pipeline;
+
+                const render::vk_buffer& draw_indirect_buffer = enable_meshlets_pipeline ? meshlets_draw_indirect_buffer
+                                                              : use_instancing           ? instanced_data.bins
+                                                                                         : indexed_draw_indirect_buffer;
+
+                // the comparisons average the frames of one draw path and cull flags only
+                const u64 draw_path = static_cast<u64>(flags) << 32 | static_cast<u64>(enable_meshlets_pipeline)
+                                    | static_cast<u64>(use_instancing) << 1
+                                    | static_cast<u64>(use_depth_only_occluders) << 2
+                                    | static_cast<u64>(enable_impostors) << 3
+                                    | static_cast<u64>(enable_atomic_compaction) << 4
+                                    | static_cast<u64>(enable_box_cull) << 5;
+                for (frame_comparison* comparison : {&sort_comparison, &box_cull_comparison})
+                {
+                    if (comparison->running && comparison->draw_path != draw_path)
+                    {
+                        comparison->restart(draw_path);
+                    }
+                }
+
+                // instanced bins have no single draw list to reorder
+                const bool use_draw_sort =
+                    (sort_comparison.running ? sort_comparison.enabled_frame() : enable_draw_sort) && !use_instancing;
+
+                const render::vk_pipeline& sort_keys_pipeline =
+                    enable_meshlets_pipeline ? meshlets_sort_keys_pipeline : indexed_sort_keys_pipeline;
+                const render::vk_pipeline& sort_reorder_pipeline =
+                    enable_meshlets_pipeline ? meshlets_sort_reorder_pipeline : indexed_sort_reorder_pipeline;
+
+                // the instanced cull pass writes visible instance ids in place of the draw count
+                const render::vk_buffer& draw_output_buffer =
+                    use_instancing ? instanced_data.instance_ids : draw_count_buffer;
+
+                auto reset_draw_output = [&](VkCommandBuffer cmd)
+                {
+                    if (use_instancing)
+                    {
+                        reset_instanced_bins(cmd, instanced_data);
+                    }
+                    else
+                    {
+                        reset_draw_count_buffer(cmd, draw_count_buffer);
+                        reset_draw_count_buffer(cmd, draw_count_buffer_16);
+                    }
+
+                    reset_impostor_draw(cmd, impostors);
+                };
+
+                auto draw = [&](VkCommandBuffer cmd, const render::vk_pipeline& pipeline)
+                {
+                    if (use_instancing)
+                    {
+                        draw_scene_instanced(
+                            cmd, pipeline, geometry_pool, meshes_data, meshes_transforms, instanced_data);
+                        return;
+                    }
+
+                    draw_scene(enable_meshlets_pipeline,
+                               cmd,
+                               pipeline,
+                               geometry_pool,
+                               meshes_data,
+                               meshes_transforms,
+                               draw_count_buffer,
+                               use_draw_sort ? draw_sort.sorted_draw_cmds : draw_indirect_buffer,
+                               draw_count_buffer_16,
+                               use_draw_sort ? draw_sort.sorted_draw_cmds_16 : indexed16_draw_indirect_buffer,
+                               frame_cull_data_buffer,
+                               instance_slots.allocator.slots_end);
+                };
+
+                auto draw_impostors_if_enabled = [&](VkCommandBuffer cmd)
+                {
+                    if (enable_impostors)
+                    {
+                        draw_impostors(cmd,
+                                       impostor_pipeline,
+                                       impostors,
+                                       meshes_data,
+                                       meshes_transforms,
+                                       camera_proj_view,
+                                       camera_transform.position);
+                    }
+                };
+
+                auto sort = [&](VkCommandBuffer cmd)
+                {
+                    if (!use_draw_sort)
+                    {
+                        return;
+                    }
+
+                    render::cmd_stage_barrier(cmd,
+                                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                              VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+                    render::sort_draws(cmd,
+                                       sort_keys_pipeline,
+                                       sort_reorder_pipeline,
+                                       draw_sort,
+                                       meshes_data,
+                                       meshes_transforms,
+                                       draw_count_buffer,
+                                       draw_indirect_buffer,
+                                       draw_sort.sorted_draw_cmds,
+                                       frame_cull_data_buffer,
+                                       instance_slots.allocator.slots_end);
+
+                    if (enable_meshlets_pipeline)
+                    {
+                        return;
+                    }
+
+                    // the u16 stream reuses the sort scratch buffers once the first sort is done with them
+                    render::cmd_stage_barrier(
+                        cmd,
+                        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+                    render::sort_draws(cmd,
+                                       sort_keys_pipeline,
+                                       sort_reorder_pipeline,
+                                       draw_sort,
+                                       meshes_data,
+                                       meshes_transforms,
+                                       draw_count_buffer_16,
+                                       indexed16_draw_indirect_buffer,
+                                       draw_sort.sorted_draw_cmds_16,
+                                       frame_cull_data_buffer,
+                                       instance_slots.allocator.slots_end);
+                };
+
+                {
+                    TRACY_ONLY(TracyVkZone(renderer.get_frame_tracy_context(), buffer, "upload instance slots"));
+
+                    render::upload_instance_updates(buffer,
+                                                    renderer,
+                                                    instance_scatter_pipeline,
+                                                    instance_updates_buffers[renderer.get_frame_index()],
+                                                    meshes_transforms,
+                                                    meshes_data,
+                                                    mesh_visibility_buffer,
+                                                    clusters_data,
+                                                    instance_slots);
+                }
+
+                {
+                    TRACY_ONLY(TracyVkZone(renderer.get_frame_tracy_context(), buffer, "upload moved transforms"));
+
+                    render::upload_dirty_transforms(buffer,
+                                                    renderer,
+                                                    transform_scatter_pipeline,
+                                                    transform_updates_buffers[renderer.get_frame_index()],
+                                                    meshes_transforms,
+                                                    clusters_data,
+                                                    scene_models,
+                                                    client_scene);
+                }
+
+                {
+                    TRACY_ONLY(TracyVkZone(renderer.get_frame_tracy_context(), buffer, "cull clusters"));
+
+                    // both cull passes share the frustum, so the surviving clusters are reused by the second one
+                    cull_clusters(
+                        buffer, cluster_cull_pipeline, clusters_data, frame_cull_data_buffer, mesh_visibility_buffer);
+                }
+
                 {
                     TRACY_ONLY(TracyVkZone(renderer.get_frame_tracy_context(), buffer, "cull last frame occluders"));
 
-                    reset_draw_count_buffer(buffer, draw_count_buffer);
+                    reset_draw_output(buffer);
                     const render::vk_descriptor_info cull_pass_bindings[] = {meshes_data.buffer,
                                                                              meshes_transforms.buffer,
-                                                                             draw_count_buffer.buffer,
+                                                                             draw_output_buffer.buffer,
                                                                              mesh_visibility_buffer.buffer,
                                                                              frame_cull_data_buffer.buffer,
-                                                                             enable_meshlets_pipeline
-                                                                                 ? meshlets_draw_indirect_buffer.buffer
-                                                                                 : indexed_draw_indirect_buffer.buffer};
-
-                    const render::vk_pipeline& cull_pass =
-                        enable_meshlets_pipeline ? meshlets_cull_pipeline : indexed_cull_pipeline;
+                                                                             draw_indirect_buffer.buffer,
+                                                                             clusters_data.visible_clusters.buffer,
+                                                                             indexed16_draw_indirect_buffer.buffer,
+                                                                             draw_count_buffer_16.buffer,
+                                                                             impostors.draw.buffer,
+                                                                             impostors.instance_ids.buffer};
+
+                    const render::vk_pipeline& cull_pass = enable_meshlets_pipeline ? meshlets_cull_pipeline
+                                                         : use_instancing           ? instanced_cull_pipeline
+                                                                                    : indexed_cull_pipeline;
                     cull_pass.bind(buffer);
                     cull_pass.push_descriptor_set(buffer, cull_pass_bindings);
 
-                    cull_pass.dispatch(buffer, kRepeatDraws, 1, 1);
+                    cull_pass.dispatch_indirect(buffer, clusters_data.dispatch.buffer, 0);
+                    sort(buffer);
 
                     render::cmd_stage_barrier(
                         buffer,
@@ -790,20 +1862,32 @@ int main(int argc, char* argv[])
                                          VK_IMAGE_LAYOUT_UNDEFINED,
                                          VK_IMAGE_LAYOUT_GENERAL,
                                          VK_IMAGE_ASPECT_DEPTH_BIT);
+                // depth-only occluders leave the color target to the second phase, which then draws everything
                 begin_rendering(buffer,
-                                renderer.get_frame_swapchain_image().image_view,
+                                use_depth_only_occluders ? VK_NULL_HANDLE
+                                                         : renderer.get_frame_swapchain_image().image_view,
                                 depth_image.image.view,
                                 VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                VK_ATTACHMENT_LOAD_OP_CLEAR,
                                 VK_ATTACHMENT_STORE_OP_STORE,
                                 renderer.get_scissor());
 
                 vkCmdSetScissor(buffer, 0, 1, &scissor);
                 vkCmdSetViewport(buffer, 0, 1, &viewport);
 
-                const auto& render_pipeline =
-                    enable_meshlets_pipeline ? meshlets_render_pipeline : indexed_render_pipeline;
-                render_pipeline.bind(buffer);
-                render_pipeline.push_constant(buffer, pc_data {.pv = camera_proj_view});
+                const auto& render_pipeline = enable_meshlets_pipeline ? meshlets_render_pipeline
+                                            : use_instancing           ? instanced_render_pipeline
+                                                                       : indexed_render_pipeline;
+
+                const auto& depth_pipeline = use_instancing ? instanced_depth_pipeline : indexed_depth_pipeline;
+
+                const auto& occluders_pipeline = use_depth_only_occluders ? depth_pipeline : render_pipeline;
+
+                // the meshlets path has no depth-only occluders, so it never redraws over them
+                const auto& redraw_pipeline      = use_instancing ? instanced_redraw_pipeline : indexed_redraw_pipeline;
+                const auto& new_objects_pipeline = use_depth_only_occluders ? redraw_pipeline : render_pipeline;
+                occluders_pipeline.bind(buffer);
+                occluders_pipeline.push_constant(buffer, pc_data {.pv = camera_proj_view});
 
                 if (pipeline_statistics_query)
                 {
@@ -814,16 +1898,13 @@ int main(int argc, char* argv[])
                     ZoneScopedN("draw last frame occluders");
                     TRACY_ONLY(TracyVkZone(renderer.get_frame_tracy_context(), buffer, "draw last frame occluders"));
 
-                    draw_scene(enable_meshlets_pipeline,
-                               buffer,
-                               render_pipeline,
-                               geometry_pool,
-                               meshes_data,
-                               meshes_transforms,
-                               draw_count_buffer,
-                               enable_meshlets_pipeline ? meshlets_draw_indirect_buffer : indexed_draw_indirect_buffer,
-                               frame_cull_data_buffer,
-                               kRepeatDraws);
+                    draw(buffer, occluders_pipeline);
+
+                    // without a color target the second phase draws the impostors again
+                    if (!use_depth_only_occluders)
+                    {
+                        draw_impostors_if_enabled(buffer);
+                    }
                 }
 
                 if (pipeline_statistics_query)
@@ -868,24 +1949,38 @@ int main(int argc, char* argv[])
                 {
                     TRACY_ONLY(TracyVkZone(renderer.get_frame_tracy_context(), buffer, "cull new objects"));
 
-                    reset_draw_count_buffer(buffer, draw_count_buffer);
+                    reset_draw_output(buffer);
                     const render::vk_descriptor_info cull_pass_bindings[] = {
                         meshes_data.buffer,
                         meshes_transforms.buffer,
-                        draw_count_buffer.buffer,
+                        draw_output_buffer.buffer,
                         mesh_visibility_buffer.buffer,
                         frame_cull_data_buffer.buffer,
-                        enable_meshlets_pipeline ? meshlets_draw_indirect_buffer.buffer
-                                                 : indexed_draw_indirect_buffer.buffer,
+                        draw_indirect_buffer.buffer,
                         render::vk_descriptor_info(
-                            depth_pyramid.sampler, depth_pyramid.image.view, VK_IMAGE_LAYOUT_GENERAL)};
-
-                    const render::vk_pipeline& cull_pass =
-                        enable_meshlets_pipeline ? meshlets_occlusion_cull_pipeline : indexed_cull_occlusion_pipeline;
+                            depth_pyramid.sampler, depth_pyramid.image.view, VK_IMAGE_LAYOUT_GENERAL),
+                        clusters_data.visible_clusters.buffer,
+                        indexed16_draw_indirect_buffer.buffer,
+                        draw_count_buffer_16.buffer,
+                        impostors.draw.buffer,
+                        impostors.instance_ids.buffer};
+
+                    const render::vk_pipeline& cull_pass = enable_meshlets_pipeline ? meshlets_occlusion_cull_pipeline
+                                                         : use_instancing ? instanced_cull_occlusion_pipeline
+                                                                          : indexed_cull_occlusion_pipeline;
                     cull_pass.bind(buffer);
                     cull_pass.push_descriptor_set(buffer, cull_pass_bindings);
 
-                    cull_pass.dispatch(buffer, kRepeatDraws, 1, 1);
+                    cull_pass.dispatch_indirect(buffer, clusters_data.dispatch.buffer, 0);
+                    sort(buffer);
+
+                    // the visible instances count is read back once the frame is done
+                    render::cmd_buffer_barrier(buffer,
+                                               frame_cull_data_buffer.buffer,
+                                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                               VK_ACCESS_SHADER_WRITE_BIT,
+                                               VK_PIPELINE_STAGE_HOST_BIT,
+                                               VK_ACCESS_HOST_READ_BIT);
 
                     render::cmd_stage_barrier(
                         buffer,
@@ -902,19 +1997,27 @@ int main(int argc, char* argv[])
                     begin_rendering(buffer,
                                     renderer.get_frame_swapchain_image().image_view,
                                     depth_image.image.view,
+                                    use_depth_only_occluders ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
                                     VK_ATTACHMENT_LOAD_OP_LOAD,
                                     VK_ATTACHMENT_STORE_OP_STORE,
                                     renderer.get_scissor());
-                    draw_scene(enable_meshlets_pipeline,
-                               buffer,
-                               render_pipeline,
-                               geometry_pool,
-                               meshes_data,
-                               meshes_transforms,
-                               draw_count_buffer,
-                               enable_meshlets_pipeline ? meshlets_draw_indirect_buffer : indexed_draw_indirect_buffer,
-                               frame_cull_data_buffer,
-                               kRepeatDraws);
+
+                    new_objects_pipeline.bind(buffer);
+                    new_objects_pipeline.push_constant(buffer, pc_data {.pv = camera_proj_view});
+
+                    // the second phase has its own query, as a query can't span render pass instances
+                    if (pipeline_statistics_query)
+                    {
+                        vkCmdBeginQuery(buffer, pipeline_statistics_query, 1, 0);
+                    }
+
+                    draw(buffer, new_objects_pipeline);
+                    draw_impostors_if_enabled(buffer);
+
+                    if (pipeline_statistics_query)
+                    {
+                        vkCmdEndQuery(buffer, pipeline_statistics_query, 1);
+                    }
 
                     if (freeze_cull_data)
                     {
@@ -945,6 +2048,35 @@ int main(int argc, char* argv[])
                     ImGui::BeginDisabled(!mesh_shading_supported);
                     ImGui::Checkbox("Enable meshlets path", &enable_meshlets_pipeline);
                     ImGui::EndDisabled();
+                    ImGui::BeginDisabled(enable_meshlets_pipeline);
+                    ImGui::Checkbox("Enable instanced draws", &enable_instanced_draws);
+                    ImGui::EndDisabled();
+                    if (use_instancing)
+                    {
+                        ImGui::Text("Instanced draw bins: %u", instanced_data.bins_count);
+                    }
+                    ImGui::BeginDisabled(use_instancing);
+                    ImGui::Checkbox("Sort draws front to back", &enable_draw_sort);
+                    ImGui::EndDisabled();
+                    ImGui::BeginDisabled(enable_meshlets_pipeline);
+                    ImGui::Checkbox("Depth-only occluders", &enable_depth_only_occluders);
+                    ImGui::EndDisabled();
+                    ImGui::Checkbox("Impostors for tiny instances", &enable_impostors);
+                    ImGui::BeginDisabled(use_instancing);
+                    ImGui::Checkbox("Atomic draw compaction", &enable_atomic_compaction);
+                    ImGui::EndDisabled();
+                    ImGui::Checkbox("Box frustum cull", &enable_box_cull);
+                    ImGui::SliderInt("Spinning instances", &spinning_instances, 0, static_cast<i32>(instances_count));
+                    ImGui::SliderInt("Respawned instances", &respawned_instances, 0, 10'000);
+                    ImGui::Text("Instance clusters: %u", clusters_data.clusters_count);
+                    if (*instance_capacity_error != '\0')
+                    {
+                        ImGui::TextWrapped("Instance capacity error: %s", instance_capacity_error);
+                    }
+                    ImGui::Text("Instance slots: %u live, %u used, %u capacity",
+                                instance_slots.allocator.live_count,
+                                instance_slots.allocator.slots_end,
+                                instance_slots.allocator.capacity);
 
                     ImGui::SeparatorText("gpu timings");
                     codegen::draw(profile_data);
@@ -954,12 +2086,28 @@ int main(int argc, char* argv[])
                     ImGui::Text("Tris Drawn: %s", format_big_number(profile_data.tris_in_scene_total).c_str());
 
                     ImGui::SeparatorText("gpu stats");
-                    draw_shared_buffer_stats("Vertices", geometry_pool.vertex);
+                    draw_shared_buffer_stats("Vertex positions", geometry_pool.position);
+                    draw_shared_buffer_stats("Vertex attributes", geometry_pool.attribute);
                     draw_shared_buffer_stats("Indices", geometry_pool.index);
+                    draw_shared_buffer_stats("Indices (16-bit)", geometry_pool.index16);
                     draw_shared_buffer_stats("Meshlets", geometry_pool.meshlets);
                     draw_shared_buffer_stats("Meshlets payload", geometry_pool.meshlets_payload);
+                    if (ImGui::Button("Defragment geometry pool"))
+                    {
+                        defragment_geometry_requested = true;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Unload unreferenced models"))
+                    {
+                        unload_models_requested = true;
+                    }
+
+                    if (*geometry_pool_error != '\0')
+                    {
+                        ImGui::TextWrapped("Geometry pool error: %s", geometry_pool_error);
+                    }
 
-                    ImGui::SeparatorText("Last frame pipeline stats");
+                    ImGui::SeparatorText("Last frame pipeline stats, both draw phases");
                     ImGui::Text("input_assembly_vertices: %s",
                                 format_big_number(frame_stats_data.input_assembly_vertices).c_str());
                     ImGui::Text("input_assembly_primitives: %s",
@@ -969,6 +2117,47 @@ int main(int argc, char* argv[])
                     ImGui::Text("triangles_count: %s", format_big_number(frame_stats_data.triangles_count).c_str());
                     ImGui::Text("fragment_shader_invocations: %s",
                                 format_big_number(frame_stats_data.fragment_shader_invocations).c_str());
+                    ImGui::Text("visible_instances: %s", format_big_number(visible_instances).c_str());
+
+                    ImGui::BeginDisabled(box_cull_comparison.running);
+                    if ((sort_comparison.running && ImGui::Button("Stop comparing draw orders"))
+                        || (!sort_comparison.running && ImGui::Button("Compare draw orders")))
+                    {
+                        sort_comparison.running = !sort_comparison.running;
+                        sort_comparison.restart(sort_comparison.draw_path);
+                    }
+                    ImGui::EndDisabled();
+
+                    if (sort_comparison.frames[0] > 0 && sort_comparison.frames[1] > 0)
+                    {
+                        const f64 unsorted = sort_comparison.average(false);
+                        const f64 sorted   = sort_comparison.average(true);
+                        ImGui::Text("fragment_shader_invocations unsorted/sorted: %s/%s (%.2lf%% fewer, %u frames)",
+                                    format_big_number(static_cast<u64>(unsorted)).c_str(),
+                                    format_big_number(static_cast<u64>(sorted)).c_str(),
+                                    100.0 - sorted * 100.0 / std::max(unsorted, 1.0),
+                                    sort_comparison.frames[0] + sort_comparison.frames[1]);
+                    }
+
+                    ImGui::BeginDisabled(sort_comparison.running);
+                    if ((box_cull_comparison.running && ImGui::Button("Stop comparing box cull"))
+                        || (!box_cull_comparison.running && ImGui::Button("Compare box cull")))
+                    {
+                        box_cull_comparison.running = !box_cull_comparison.running;
+                        box_cull_comparison.restart(box_cull_comparison.draw_path);
+                    }
+                    ImGui::EndDisabled();
+
+                    if (box_cull_comparison.frames[0] > 0 && box_cull_comparison.frames[1] > 0)
+                    {
+                        const f64 sphere_only = box_cull_comparison.average(false);
+                        const f64 with_box    = box_cull_comparison.average(true);
+                        ImGui::Text("visible_instances box test off/on: %s/%s (%.2lf%% fewer, %u frames)",
+                                    format_big_number(static_cast<u64>(sphere_only)).c_str(),
+                                    format_big_number(static_cast<u64>(with_box)).c_str(),
+                                    100.0 - with_box * 100.0 / std::max(sphere_only, 1.0),
+                                    box_cull_comparison.frames[0] + box_cull_comparison.frames[1]);
+                    }
 
                     ImGui::SeparatorText("render controls");
 
@@ -980,6 +2169,7 @@ int main(int argc, char* argv[])
                         "Meshlets cone cull",
                         "Meshlets frustum cull",
                         "Meshlets occlusion cull",
+                        "Triangle cull",
                     };
                     ImGuiEx::Bits(flags, names, COUNT_OF(names));
 
@@ -1057,24 +2247,64 @@ int main(int argc, char* argv[])
 
                 if (pipeline_statistics_query)
                 {
+                    pipeline_statistics_data phase_stats[2];
                     VK_ASSERT_ON_FAIL(vkGetQueryPoolResults(renderer.get_context().device,
                                                             pipeline_statistics_query,
                                                             0,
-                                                            1,
-                                                            sizeof(frame_stats_data),
-                                                            &frame_stats_data,
-                                                            sizeof(u64),
+                                                            COUNT_OF(phase_stats),
+                                                            sizeof(phase_stats),
+                                                            phase_stats,
+                                                            sizeof(phase_stats[0]),
                                                             VK_QUERY_RESULT_64_BIT));
+
+                    frame_stats_data = phase_stats[0];
+                    frame_stats_data += phase_stats[1];
+
+                    if (sort_comparison.running && !use_instancing)
+                    {
+                        sort_comparison.add(use_draw_sort, frame_stats_data.fragment_shader_invocations);
+                    }
                 }
 
-                VkPhysicalDeviceProperties props = {};
-                vkGetPhysicalDeviceProperties(renderer.get_context().physical_device, &props);
+                // the device is idle, so the second cull phase count of this frame is final
+                visible_instances = static_cast<const frame_cull_data*>(frame_cull_data_buffer.mapped)
+                                        ->visible_instances;
+                if (box_cull_comparison.running)
+                {
+                    box_cull_comparison.add(use_box_cull, visible_instances);
+                }
 
-                profile_data.update(static_cast<f64>(query_results[0]) * props.limits.timestampPeriod * 1e-6,
-                                    static_cast<f64>(query_results[1]) * props.limits.timestampPeriod * 1e-6,
+                const f32 timestamp_period = device_properties.limits.timestampPeriod;
+                profile_data.update(static_cast<f64>(query_results[0]) * timestamp_period * 1e-6,
+                                    static_cast<f64>(query_results[1]) * timestamp_period * 1e-6,
                                     frame_stats_data.triangles_count,
                                     scene_triangles_max);
 
+#if MESHLET_BENCHMARK
+                {
+                    // the first frames still pay for pipeline and cache warm up
+                    constexpr u32 kWarmupFrames   = 64;
+                    constexpr u32 kMeasuredFrames = 512;
+
+                    if (++benchmark_frames > kWarmupFrames)
+                    {
+                        benchmark_gpu_time_ms += (profile_data.frame_end - profile_data.frame_start)
+                                               / static_cast<f64>(kMeasuredFrames);
+                    }
+
+                    if (benchmark_frames == kWarmupFrames + kMeasuredFrames)
+                    {
+                        render::record_meshlet_benchmark(render::kMeshletBenchmarkRecordPath,
+                                                         device_properties.vendorID,
+                                                         device_properties.deviceID,
+                                                         meshlet_config,
+                                                         benchmark_gpu_time_ms,
+                                                         meshlet_config == 0);
+                        exit = true;
+                    }
+                }
+#endif
+
                 const auto str = cpp::stack_string::make_formatted("CPU: %.3lfms; GPU: %.3lfms; Tris/s (B): %lf",
                                                                    dt * 1000.0F,
                                                                    profile_data.gpu_render_time,
@@ -1082,6 +2312,7 @@ int main(int argc, char* argv[])
                 SDL_SetWindowTitle(client_window.get_native_handle().window, str.c_str());
 #endif
 
+                TRACY_ONLY(debug::plot_frame_heap_allocations());
                 FrameMark;
             });
     };
@@ -1100,5 +2331,14 @@ int main(int argc, char* argv[])
         client_events.poll();
     }
 
+    codegen::binary_writer settings_writer;
+    codegen::write(client_render_settings, settings_writer);
+    fs::write_file(kRenderSettingsFile, bytes(settings_writer.data.size(), settings_writer.data.data()));
+
+    // the slots and the models go out of scope before the scene
+    client_scene.on_destroy<gpu_instance_component>().disconnect(&instance_slots);
+    client_scene.on_construct<static_model_component>().disconnect(&scene_models);
+    client_scene.on_destroy<static_model_component>().disconnect(&scene_models);
+
     return 0;
 }
@@ -1,11 +1,21 @@
 #define TRACY_CALLSTACK 16
+#include <debug.hpp>
 #include <tracy/Tracy.hpp>
+#include <types.hpp>
+
+#include <atomic>
 
 #if TRACY_ENABLE
+namespace
+{
+    std::atomic<u64> heap_allocations_count;
+}
+
 void* operator new(std::size_t count)
 {
     auto ptr = malloc(count);
     TracyAlloc(ptr, count);
+    heap_allocations_count.fetch_add(1, std::memory_order_relaxed);
     return ptr;
 }
 
@@ -14,4 +24,13 @@ void operator delete(void* ptr) noexcept
     TracyFree(ptr);
     free(ptr);
 }
+
+void debug::plot_frame_heap_allocations()
+{
+    static u64 last_count = 0;
+
+    const u64 count = heap_allocations_count.load(std::memory_order_relaxed);
+    TracyPlot("heap allocations per frame", static_cast<i64>(count - last_count));
+    last_count = count;
+}
 #endif
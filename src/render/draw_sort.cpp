@@ -0,0 +1,145 @@
+#include <render/draw_sort.hpp>
+
+#include <render/platform/vk/vk_barrier.hpp>
+#include <shaders/constants.h>
+#include <tracy/Tracy.hpp>
+
+void render::create_draw_sort_buffers(const vk_renderer& renderer, draw_sort_data& result, const u32 max_draws)
+{
+    ZoneScoped;
+
+    const u32 tiles_count =
+        (max_draws + shader_constants::kRadixSortWorkGroupSize - 1) / shader_constants::kRadixSortWorkGroupSize;
+
+    for (u32 i = 0; i < 2; ++i)
+    {
+        result.keys[i] = *render::create_buffer(
+            max_draws * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, renderer.get_context().allocator, 0);
+        result.values[i] = *render::create_buffer(
+            max_draws * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, renderer.get_context().allocator, 0);
+    }
+
+    result.tile_histograms =
+        *render::create_buffer(tiles_count * shader_constants::kRadixSortBucketsCount * sizeof(u32),
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               renderer.get_context().allocator,
+                               0);
+    result.sorted_draw_cmds =
+        *render::create_buffer(max_draws * result.draw_cmd_size,
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               renderer.get_context().allocator,
+                               0);
+    result.sorted_draw_cmds_16 =
+        *render::create_buffer(max_draws * result.draw_cmd_size,
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               renderer.get_context().allocator,
+                               0);
+}
+
+void render::destroy_draw_sort_buffers(const vk_renderer& renderer, draw_sort_data& draw_sort)
+{
+    for (u32 i = 0; i < 2; ++i)
+    {
+        render::destroy_buffer(renderer.get_context().allocator, draw_sort.keys[i]);
+        render::destroy_buffer(renderer.get_context().allocator, draw_sort.values[i]);
+    }
+
+    render::destroy_buffer(renderer.get_context().allocator, draw_sort.tile_histograms);
+    render::destroy_buffer(renderer.get_context().allocator, draw_sort.sorted_draw_cmds);
+    render::destroy_buffer(renderer.get_context().allocator, draw_sort.sorted_draw_cmds_16);
+}
+
+render::draw_sort_data render::create_draw_sort_data(const vk_renderer& renderer, const u32 max_draws,
+                                                      const u32 draw_cmd_size)
+{
+    ZoneScoped;
+
+    draw_sort_data result {
+        .histogram = *render::vk_pipeline::create_compute(
+            renderer, *render::vk_shader::load(renderer, "../shaders/bin/radix_sort_histogram.comp.spv")),
+        .scan = *render::vk_pipeline::create_compute(
+            renderer, *render::vk_shader::load(renderer, "../shaders/bin/radix_sort_scan.comp.spv")),
+        .scatter = *render::vk_pipeline::create_compute(
+            renderer, *render::vk_shader::load(renderer, "../shaders/bin/radix_sort_scatter.comp.spv")),
+        .draw_cmd_size = draw_cmd_size,
+    };
+
+    create_draw_sort_buffers(renderer, result, max_draws);
+    return result;
+}
+
+void render::sort_draws(VkCommandBuffer cmd, const vk_pipeline& keys_pipeline, const vk_pipeline& reorder_pipeline,
+                        const draw_sort_data& sort_data, const vk_buffer& meshes_data,
+                        const vk_buffer& meshes_transforms, const vk_buffer& draw_count_buffer,
+                        const vk_buffer& draw_indirect_cmds_buffer, const vk_buffer& sorted_draw_cmds_buffer,
+                        const vk_mapped_buffer& frame_cull_data_buffer, const u32 max_draws)
+{
+    auto compute_barrier = [cmd]()
+    {
+        render::cmd_stage_barrier(cmd,
+                                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    };
+
+    // every pass is dispatched for max_draws and skips anything past the culled draw count
+    {
+        const render::vk_descriptor_info bindings[] = {meshes_data.buffer,
+                                                       meshes_transforms.buffer,
+                                                       draw_count_buffer.buffer,
+                                                       draw_indirect_cmds_buffer.buffer,
+                                                       frame_cull_data_buffer.buffer,
+                                                       sort_data.keys[0].buffer,
+                                                       sort_data.values[0].buffer};
+        keys_pipeline.bind(cmd);
+        keys_pipeline.push_descriptor_set(cmd, bindings);
+        keys_pipeline.dispatch(cmd, max_draws, 1, 1);
+        compute_barrier();
+    }
+
+    for (u32 shift = 0, src = 0; shift < shader_constants::kDrawSortKeyBits;
+         shift += shader_constants::kRadixSortDigitBits, src ^= 1)
+    {
+        const u32 dst = src ^ 1;
+
+        const render::vk_descriptor_info histogram_bindings[] = {
+            draw_count_buffer.buffer, sort_data.keys[src].buffer, sort_data.tile_histograms.buffer};
+        sort_data.histogram.bind(cmd);
+        sort_data.histogram.push_descriptor_set(cmd, histogram_bindings);
+        sort_data.histogram.push_constant(cmd, shift);
+        sort_data.histogram.dispatch(cmd, max_draws, 1, 1);
+        compute_barrier();
+
+        const render::vk_descriptor_info scan_bindings[] = {draw_count_buffer.buffer,
+                                                            sort_data.tile_histograms.buffer};
+        sort_data.scan.bind(cmd);
+        sort_data.scan.push_descriptor_set(cmd, scan_bindings);
+        sort_data.scan.dispatch(cmd, 1, 1, 1);
+        compute_barrier();
+
+        const render::vk_descriptor_info scatter_bindings[] = {draw_count_buffer.buffer,
+                                                               sort_data.keys[src].buffer,
+                                                               sort_data.values[src].buffer,
+                                                               sort_data.tile_histograms.buffer,
+                                                               sort_data.keys[dst].buffer,
+                                                               sort_data.values[dst].buffer};
+        sort_data.scatter.bind(cmd);
+        sort_data.scatter.push_descriptor_set(cmd, scatter_bindings);
+        sort_data.scatter.push_constant(cmd, shift);
+        sort_data.scatter.dispatch(cmd, max_draws, 1, 1);
+        compute_barrier();
+    }
+
+    // an even number of radix passes leaves the sorted values back in the first buffer
+    static_assert(shader_constants::kDrawSortKeyBits / shader_constants::kRadixSortDigitBits % 2 == 0);
+    {
+        const render::vk_descriptor_info bindings[] = {draw_count_buffer.buffer,
+                                                       sort_data.values[0].buffer,
+                                                       draw_indirect_cmds_buffer.buffer,
+                                                       sorted_draw_cmds_buffer.buffer};
+        reorder_pipeline.bind(cmd);
+        reorder_pipeline.push_descriptor_set(cmd, bindings);
+        reorder_pipeline.dispatch(cmd, max_draws, 1, 1);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <render/platform/vk/vk_buffer.hpp>
+#include <render/platform/vk/vk_pipeline.hpp>
+#include <render/platform/vk/vk_renderer.hpp>
+
+namespace render
+{
+    // Front-to-back sort of the culled draw list: 16-bit view depth keys radix sorted on the gpu, then the draw
+    // commands are gathered in sorted order into a separate indirect buffer
+    struct draw_sort_data
+    {
+        vk_pipeline histogram;
+        vk_pipeline scan;
+        vk_pipeline scatter;
+
+        vk_buffer keys[2];              // ping-pong between radix passes
+        vk_buffer values[2];            // unsorted draw command index of each key
+        vk_buffer tile_histograms;      // per tile digit counts, scanned in place into output offsets
+        vk_buffer sorted_draw_cmds;     // draw commands gathered in front-to-back order
+        vk_buffer sorted_draw_cmds_16;  // same for the draws of the 16-bit index stream
+
+        u32 draw_cmd_size {0};  // largest draw command of the draw paths sorted
+    };
+
+    // draw_cmd_size is the largest indirect command the sorted buffers hold, whichever draw path is sorted
+    draw_sort_data create_draw_sort_data(const vk_renderer& renderer, u32 max_draws, u32 draw_cmd_size);
+
+    // the buffers hold max_draws draws, the pipelines are kept when they are recreated for more draws
+    void create_draw_sort_buffers(const vk_renderer& renderer, draw_sort_data& result, u32 max_draws);
+
+    void destroy_draw_sort_buffers(const vk_renderer& renderer, draw_sort_data& draw_sort);
+
+    // Sorts the culled draw commands front to back into sorted_draw_cmds_buffer. Every pass is dispatched for
+    // max_draws and skips anything past the draw count.
+    void sort_draws(VkCommandBuffer cmd, const vk_pipeline& keys_pipeline, const vk_pipeline& reorder_pipeline,
+                    const draw_sort_data& sort_data, const vk_buffer& meshes_data, const vk_buffer& meshes_transforms,
+                    const vk_buffer& draw_count_buffer, const vk_buffer& draw_indirect_cmds_buffer,
+                    const vk_buffer& sorted_draw_cmds_buffer, const vk_mapped_buffer& frame_cull_data_buffer,
+                    u32 max_draws);
+}
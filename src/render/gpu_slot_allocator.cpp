@@ -0,0 +1,81 @@
+#include <render/gpu_slot_allocator.hpp>
+
+#include <assert2.hpp>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <bit>
+
+render::gpu_slot_allocator::gpu_slot_allocator(const u32 capacity)
+    : capacity(capacity)
+    , free_words((capacity + 63) / 64, ~0ULL)
+{
+    // the bits past the capacity are never free
+    if (capacity % 64 != 0)
+    {
+        free_words.back() = (1ULL << (capacity % 64)) - 1;
+    }
+}
+
+u32 render::gpu_slot_allocator::allocate()
+{
+    ZoneScoped;
+
+    // every word below first_free_word is full
+    while (first_free_word < free_words.size() && free_words[first_free_word] == 0)
+    {
+        ++first_free_word;
+    }
+
+    if (first_free_word == free_words.size())
+    {
+        return kInvalidSlot;
+    }
+
+    u64& word      = free_words[first_free_word];
+    const u32 slot = first_free_word * 64 + static_cast<u32>(std::countr_zero(word));
+    word &= word - 1;
+
+    ++live_count;
+    slots_end = std::max(slots_end, slot + 1);
+
+    return slot;
+}
+
+void render::gpu_slot_allocator::free(const u32 slot)
+{
+    ZoneScoped;
+
+    assert2(slot < capacity && !is_free(slot));
+
+    free_words[slot / 64] |= 1ULL << (slot % 64);
+    first_free_word = std::min(first_free_word, slot / 64);
+    --live_count;
+
+    // trailing free slots are dropped from the range the gpu passes cover
+    while (slots_end > 0 && is_free(slots_end - 1))
+    {
+        --slots_end;
+    }
+}
+
+void render::gpu_slot_allocator::grow(const u32 new_capacity)
+{
+    ZoneScoped;
+
+    assert2(new_capacity >= capacity);
+
+    free_words.resize((new_capacity + 63) / 64, 0);
+    for (u32 slot = capacity; slot < new_capacity; ++slot)
+    {
+        free_words[slot / 64] |= 1ULL << (slot % 64);
+    }
+
+    first_free_word = std::min(first_free_word, capacity / 64);
+    capacity        = new_capacity;
+}
+
+bool render::gpu_slot_allocator::is_free(const u32 slot) const
+{
+    return ((free_words[slot / 64] >> (slot % 64)) & 1) != 0;
+}
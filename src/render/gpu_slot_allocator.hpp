@@ -0,0 +1,36 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <limits>
+#include <vector>
+
+namespace render
+{
+    // Stable slots of the per-instance gpu tables, a slot keeps its index from allocate to free. The lowest free slot
+    // is handed out first, so the live slots stay packed below slots_end and the cull dispatch only has to cover those.
+    struct gpu_slot_allocator
+    {
+        static constexpr u32 kInvalidSlot = std::numeric_limits<u32>::max();
+
+        u32 capacity {0};
+        u32 live_count {0};
+        u32 slots_end {0};  // one past the highest allocated slot
+        u32 first_free_word {0};
+        std::vector<u64> free_words;  // one bit per slot, set while the slot is free
+
+        gpu_slot_allocator() = default;
+
+        explicit gpu_slot_allocator(u32 capacity);
+
+        // kInvalidSlot once all capacity slots are allocated
+        u32 allocate();
+
+        void free(u32 slot);
+
+        // the slots past the previous capacity are free, the allocated ones keep their index
+        void grow(u32 new_capacity);
+
+        [[nodiscard]] bool is_free(u32 slot) const;
+    };
+}
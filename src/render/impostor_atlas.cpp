@@ -0,0 +1,251 @@
+#include <render/impostor_atlas.hpp>
+#include <render/model_registry.hpp>
+#include <render/platform/vk/vk_buffer_transfer.hpp>
+#include <render/platform/vk/vk_command_buffer.hpp>
+#include <render/static_model.hpp>
+#include <shaders/constants.h>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+
+namespace
+{
+    struct bake_pc_data
+    {
+        vec4 sphere;
+        vec4 position_bounds;
+        uvec4 cell;
+    };
+
+    // first lod of a model within the bake index buffer
+    struct bake_draw
+    {
+        u32 first_index {0};
+        u32 indices_count {0};
+    };
+}
+
+result<render::impostor_atlas> render::bake_impostor_atlas(const vk_renderer& renderer,
+                                                           const vk_scene_geometry_pool& pool,
+                                                           const vk_pipeline& bake_pipeline,
+                                                           const std::vector<const static_model*>& models)
+{
+    ZoneScoped;
+    using namespace shader_constants;
+
+    const auto& context = renderer.get_context();
+
+    const u32 rows = std::max((pool.geometry_count + kImpostorTilesPerRow - 1) / kImpostorTilesPerRow, 1U);
+    const uvec2 size(kImpostorTilesPerRow * kImpostorTileSize, rows * kImpostorTileSize);
+
+    VkPhysicalDeviceProperties device_properties = {};
+    vkGetPhysicalDeviceProperties(context.physical_device, &device_properties);
+    if (size.y > device_properties.limits.maxImageDimension2D)
+    {
+        return "Too many geometries for a single impostor atlas";
+    }
+
+    // the bake reuses the scene pipeline state, so the atlas shares the swapchain formats
+    VkImageCreateInfo image_create_info {
+        .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType     = VK_IMAGE_TYPE_2D,
+        .format        = renderer.get_swapchain().surface_format.format,
+        .extent        = {size.x, size.y, 1},
+        .mipLevels     = 1,
+        .arrayLayers   = 1,
+        .samples       = VK_SAMPLE_COUNT_1_BIT,
+        .tiling        = VK_IMAGE_TILING_OPTIMAL,
+        .usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    auto image = render::create_image(context.device, image_create_info, VK_IMAGE_ASPECT_COLOR_BIT, context.allocator);
+    if (!image)
+    {
+        return image.message;
+    }
+
+    image_create_info.format = renderer.get_swapchain().depth_format;
+    image_create_info.usage  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+    auto depth = render::create_image(context.device, image_create_info, VK_IMAGE_ASPECT_DEPTH_BIT, context.allocator);
+    if (!depth)
+    {
+        render::destroy_image(context.device, context.allocator, *image);
+        return depth.message;
+    }
+
+    // the first lod references the geometry vertices directly, so its indices only need widening to u32
+    std::vector<u32> indices;
+    std::vector<bake_draw> draws(models.size());
+    for (u32 i = 0; i < models.size(); ++i)
+    {
+        const static_model::lod& lod          = models[i]->lod_array[0];
+        const vk_geometry_host_data& host_data = pool.host_geometries[models[i]->geometry_id];
+
+        draws[i] = bake_draw {.first_index = static_cast<u32>(indices.size()), .indices_count = lod.indices_count};
+        if (lod.short_indices)
+        {
+            indices.insert(indices.end(), host_data.indices16.begin(), host_data.indices16.begin() + lod.indices_count);
+        }
+        else
+        {
+            indices.insert(indices.end(), host_data.indices.begin(), host_data.indices.begin() + lod.indices_count);
+        }
+    }
+
+    auto index_buffer = render::create_buffer(std::max<u64>(indices.size() * sizeof(u32), sizeof(u32)),
+                                              VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                              context.allocator,
+                                              0);
+    if (!index_buffer)
+    {
+        render::destroy_image(context.device, context.allocator, *depth);
+        render::destroy_image(context.device, context.allocator, *image);
+        return index_buffer.message;
+    }
+
+    if (!indices.empty())
+    {
+        render::upload_data(pool.transfer, *index_buffer, indices.data(), indices.size());
+    }
+
+    const queue_data& queue = context.queues[queue_kind::eGfx];
+    const auto submitted    = render::submit_once(
+        context.device,
+        queue.queue,
+        queue.family,
+        [&](VkCommandBuffer cmd)
+        {
+            render::transition_image(
+                cmd, image->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            render::transition_image(
+                cmd, depth->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+
+            const VkRenderingAttachmentInfo color_attachment_info {
+                .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                .imageView   = image->view,
+                .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp     = VK_ATTACHMENT_STORE_OP_STORE,
+                .clearValue  = {.color = {0.0F, 0.0F, 0.0F, 0.0F}},
+            };
+
+            const VkRenderingAttachmentInfo depth_attachment_info {
+                .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                .imageView   = depth->view,
+                .imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                .loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp     = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .clearValue  = {.depthStencil = {0.0F, 0}},
+            };
+
+            const VkRect2D area {.extent = {size.x, size.y}};
+            const VkRenderingInfo rendering_info {
+                .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+                .renderArea           = area,
+                .layerCount           = 1,
+                .colorAttachmentCount = 1,
+                .pColorAttachments    = &color_attachment_info,
+                .pDepthAttachment     = &depth_attachment_info,
+            };
+
+            vkCmdBeginRendering(cmd, &rendering_info);
+            vkCmdSetScissor(cmd, 0, 1, &area);
+
+            const vk_descriptor_info bindings[] = {pool.position.buffer.buffer, pool.attribute.buffer.buffer};
+            bake_pipeline.bind(cmd);
+            bake_pipeline.push_descriptor_set(cmd, bindings);
+            vkCmdBindIndexBuffer(cmd, index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+            // one viewport per view, the vertex shader maps the bounding sphere onto it
+            for (u32 i = 0; i < models.size(); ++i)
+            {
+                const static_model& model = *models[i];
+                const uvec2 tile(model.geometry_id % kImpostorTilesPerRow, model.geometry_id / kImpostorTilesPerRow);
+
+                for (u32 y = 0; y < kImpostorGridSize; ++y)
+                {
+                    for (u32 x = 0; x < kImpostorGridSize; ++x)
+                    {
+                        const vec2 origin = vec2(tile * kImpostorTileSize + uvec2(x, y) * kImpostorViewSize);
+                        const VkViewport viewport {
+                            .x        = origin.x,
+                            .y        = origin.y,
+                            .width    = static_cast<f32>(kImpostorViewSize),
+                            .height   = static_cast<f32>(kImpostorViewSize),
+                            .minDepth = 0.0F,
+                            .maxDepth = 1.0F,
+                        };
+                        vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+                        bake_pipeline.push_constant(cmd,
+                                                    bake_pc_data {
+                                                        .sphere          = model.b_sphere,
+                                                        .position_bounds = model.position_bounds,
+                                                        .cell            = uvec4(x, y, 0, 0),
+                                                    });
+                        vkCmdDrawIndexed(cmd,
+                                         draws[i].indices_count,
+                                         1,
+                                         draws[i].first_index,
+                                         static_cast<i32>(model.base_vertex),
+                                         0);
+                    }
+                }
+            }
+
+            vkCmdEndRendering(cmd);
+            render::transition_image(
+                cmd, image->image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        });
+
+    render::destroy_buffer(context.allocator, *index_buffer);
+    render::destroy_image(context.device, context.allocator, *depth);
+    if (!submitted)
+    {
+        render::destroy_image(context.device, context.allocator, *image);
+        return submitted.message;
+    }
+
+    return impostor_atlas {
+        .image   = *image,
+        .sampler = *render::create_sampler(
+            context.device, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE),
+    };
+}
+
+render::impostor_draw_data render::create_impostor_draw_data(const vk_renderer& renderer,
+                                                              const vk_scene_geometry_pool& geometry_pool,
+                                                              const vk_pipeline& bake_pipeline,
+                                                              const model_registry& scene_models,
+                                                              const u32 instances_count)
+{
+    ZoneScoped;
+
+    std::vector<const static_model*> geometry_models;
+    for (const auto& record : scene_models.records)
+    {
+        if (record.loaded)
+        {
+            geometry_models.push_back(&record.model);
+        }
+    }
+
+    impostor_draw_data result {
+        .atlas = *render::bake_impostor_atlas(renderer, geometry_pool, bake_pipeline, geometry_models),
+    };
+
+    result.draw = *render::create_buffer(
+        sizeof(VkDrawIndirectCommand),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+    result.instance_ids = *render::create_buffer(std::max<u64>(instances_count * sizeof(u32), sizeof(u32)),
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                 renderer.get_context().allocator,
+                                                 0);
+
+    return result;
+}
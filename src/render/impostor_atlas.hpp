@@ -0,0 +1,48 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <render/platform/vk/vk_geometry_pool.hpp>
+#include <render/platform/vk/vk_image.hpp>
+#include <render/platform/vk/vk_pipeline.hpp>
+#include <render/platform/vk/vk_renderer.hpp>
+#include <result.hpp>
+
+#include <vector>
+
+struct static_model;
+
+namespace render
+{
+    struct model_registry;
+
+    // Octahedral impostors of the pool geometry: one kImpostorTileSize tile per geometry id, kImpostorTilesPerRow
+    // tiles to a row, each a grid of orthographic views of the bounding sphere (see shaders/common.glsl). Texels hold
+    // the object space normal, alpha is zero where the geometry does not cover the view.
+    struct impostor_atlas
+    {
+        vk_image image;
+        VkSampler sampler {VK_NULL_HANDLE};
+    };
+
+    // Renders the first lod of the given models, one per geometry id, with the impostor_bake shaders. The indices come
+    // from the pool host copies, so the bake does not depend on the geometry residency. Stalls the device.
+    result<impostor_atlas> bake_impostor_atlas(const vk_renderer& renderer, const vk_scene_geometry_pool& pool,
+                                               const vk_pipeline& bake_pipeline,
+                                               const std::vector<const static_model*>& models);
+
+    // Instances the cull passes routed to their impostor, drawn as one camera facing quad each with a single draw
+    struct impostor_draw_data
+    {
+        impostor_atlas atlas;
+        vk_buffer draw;          // VkDrawIndirectCommand, instance_count is accumulated by the cull passes
+        vk_buffer instance_ids;  // ids of the instances drawn as impostors
+    };
+
+    // bakes the impostors of every loaded model, instance_ids holds instances_count ids
+    impostor_draw_data create_impostor_draw_data(const vk_renderer& renderer,
+                                                 const vk_scene_geometry_pool& geometry_pool,
+                                                 const vk_pipeline& bake_pipeline,
+                                                 const model_registry& scene_models,
+                                                 u32 instances_count);
+}
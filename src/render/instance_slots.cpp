@@ -0,0 +1,447 @@
+#include <render/instance_slots.hpp>
+
+#include <assert2.hpp>
+#include <cpp/memory/linear_arena.hpp>
+#include <render/platform/vk/vk_barrier.hpp>
+#include <shaders/constants.h>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    // spreads the low 10 bits of value so that there are two zero bits between each of them
+    u32 expand_morton_bits(u32 value)
+    {
+        value = (value * 0x00010001U) & 0xFF0000FFU;
+        value = (value * 0x00000101U) & 0x0F00F00FU;
+        value = (value * 0x00000011U) & 0xC30C30C3U;
+        value = (value * 0x00000005U) & 0x49249249U;
+        return value;
+    }
+
+    // free slots have a negative radius, like the clusters without a single live slot
+    constexpr vec4 kEmptySphere {0.0F, 0.0F, 0.0F, -1.0F};
+
+    // replaces the frame's updates buffer with a larger one, the frame's previous submission is complete by then
+    void reserve_updates_buffer(const render::vk_renderer& renderer, render::vk_mapped_buffer& updates_buffer,
+                                const u64 required_size)
+    {
+        if (required_size <= updates_buffer.size)
+        {
+            return;
+        }
+
+        const u64 capacity = render::grow_capacity(updates_buffer.size, required_size);
+        render::destroy_buffer(renderer.get_context().allocator, updates_buffer);
+        updates_buffer = *render::create_buffer_mapped(capacity,
+                                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                       renderer.get_context().allocator,
+                                                       VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    }
+}
+
+render::instance_clusters_data render::create_instance_clusters_data(const vk_renderer& renderer, const u32 max_draws)
+{
+    ZoneScoped;
+
+    // cluster_cull.comp clears the visibility of a culled cluster as a whole mesh visibility word
+    static_assert(shader_constants::kCullWorkGroupSize == 32);
+
+    const u32 clusters_max =
+        (max_draws + shader_constants::kCullWorkGroupSize - 1) / shader_constants::kCullWorkGroupSize;
+    const u32 cluster_tiles_max =
+        (clusters_max + shader_constants::kCullWorkGroupSize - 1) / shader_constants::kCullWorkGroupSize;
+
+    instance_clusters_data result;
+    result.clusters = *render::create_buffer(clusters_max * sizeof(instance_cluster),
+                                             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                             renderer.get_context().allocator,
+                                             0);
+    result.visible_clusters = *render::create_buffer(
+        clusters_max * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, renderer.get_context().allocator, 0);
+
+    // dispatch command (3 u32) and the scan tile counter, followed by one look-back state per cluster cull workgroup
+    result.dispatch = *render::create_buffer(
+        sizeof(u32) * (4 + cluster_tiles_max),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        renderer.get_context().allocator,
+        0);
+
+    return result;
+}
+
+void render::destroy_instance_clusters_buffers(const vk_renderer& renderer, instance_clusters_data& clusters_data)
+{
+    render::destroy_buffer(renderer.get_context().allocator, clusters_data.clusters);
+    render::destroy_buffer(renderer.get_context().allocator, clusters_data.visible_clusters);
+    render::destroy_buffer(renderer.get_context().allocator, clusters_data.dispatch);
+}
+
+void render::grow_instance_clusters(const vk_renderer& renderer, const vk_buffer_transfer& transfer,
+                                    instance_clusters_data& clusters_data, const u32 capacity)
+{
+    ZoneScoped;
+
+    instance_clusters_data grown_clusters = create_instance_clusters_data(renderer, capacity);
+    grown_clusters.clusters_count         = clusters_data.clusters_count;
+    grown_clusters.host_clusters          = std::move(clusters_data.host_clusters);
+    grown_clusters.slot_spheres           = std::move(clusters_data.slot_spheres);
+    grown_clusters.host_clusters.resize(
+        (capacity + shader_constants::kCullWorkGroupSize - 1) / shader_constants::kCullWorkGroupSize,
+        instance_cluster {.radius = kEmptySphere.w});
+    grown_clusters.slot_spheres.resize(capacity, kEmptySphere);
+
+    destroy_instance_clusters_buffers(renderer, clusters_data);
+    clusters_data = std::move(grown_clusters);
+    upload_data(
+        transfer, clusters_data.clusters, clusters_data.host_clusters.data(), clusters_data.host_clusters.size());
+}
+
+vec4 render::instance_sphere(const transform_component& tc, const static_model& model)
+{
+    const vec3 center = tc.position + tc.rotation * vec3(model.b_sphere) * tc.uniform_scale;
+    return vec4(center, model.b_sphere.w * tc.uniform_scale);
+}
+
+void render::fit_cluster(instance_clusters_data& clusters_data, const u32 cluster_index)
+{
+    constexpr u32 kClusterSize = shader_constants::kCullWorkGroupSize;
+
+    const auto& spheres = clusters_data.slot_spheres;
+    const u32 first     = cluster_index * kClusterSize;
+    const u32 last      = std::min(first + kClusterSize, static_cast<u32>(spheres.size()));
+
+    vec3 cluster_min(std::numeric_limits<f32>::max());
+    vec3 cluster_max(std::numeric_limits<f32>::lowest());
+    for (u32 i = first; i < last; ++i)
+    {
+        if (spheres[i].w >= 0.0F)
+        {
+            cluster_min = glm::min(cluster_min, vec3(spheres[i]));
+            cluster_max = glm::max(cluster_max, vec3(spheres[i]));
+        }
+    }
+
+    auto& cluster = clusters_data.host_clusters[cluster_index];
+    if (cluster_min.x > cluster_max.x)
+    {
+        cluster = instance_cluster {.radius = kEmptySphere.w};
+        return;
+    }
+
+    cluster = instance_cluster {.center = (cluster_min + cluster_max) * 0.5F, .radius = 0.0F};
+    for (u32 i = first; i < last; ++i)
+    {
+        if (spheres[i].w >= 0.0F)
+        {
+            cluster.radius = glm::max(cluster.radius, glm::distance(cluster.center, vec3(spheres[i])) + spheres[i].w);
+        }
+    }
+}
+
+void render::refit_clusters(VkCommandBuffer cmd, instance_clusters_data& clusters_data, std::span<u32> dirty_clusters)
+{
+    std::sort(dirty_clusters.begin(), dirty_clusters.end());
+    for (const u32 c : std::span(dirty_clusters.begin(), std::unique(dirty_clusters.begin(), dirty_clusters.end())))
+    {
+        fit_cluster(clusters_data, c);
+        vkCmdUpdateBuffer(cmd,
+                          clusters_data.clusters.buffer,
+                          c * sizeof(instance_cluster),
+                          sizeof(instance_cluster),
+                          &clusters_data.host_clusters[c]);
+    }
+}
+
+void render::upload_draw_data(const vk_buffer_transfer& transfer, const vk_buffer& transform_buffer,
+                              const vk_buffer& mesh_data_buffer, instance_clusters_data& clusters_data,
+                              instance_slots_data& slots, const model_registry& scene_models, scene& scene)
+{
+    ZoneScoped;
+
+    auto&& view              = scene.get_view<transform_component, static_model_component>();
+    const u64 view_size_hint = view.size_hint();
+
+    std::vector<entt::entity> instance_entities;
+    std::vector<const transform_component*> instance_transforms;
+    std::vector<const static_model*> instance_models;
+    std::vector<vec4> instance_spheres;
+    instance_entities.reserve(view_size_hint);
+    instance_transforms.reserve(view_size_hint);
+    instance_models.reserve(view_size_hint);
+    instance_spheres.reserve(view_size_hint);
+
+    vec3 scene_min(std::numeric_limits<f32>::max());
+    vec3 scene_max(std::numeric_limits<f32>::lowest());
+    view.each(
+        [&](const entt::entity entity, const transform_component& tc, const static_model_component& smc)
+        {
+            const static_model& model = scene_models.get(smc.handle);
+            const vec4 sphere         = instance_sphere(tc, model);
+            scene_min         = glm::min(scene_min, vec3(sphere));
+            scene_max         = glm::max(scene_max, vec3(sphere));
+
+            instance_entities.push_back(entity);
+            instance_transforms.push_back(&tc);
+            instance_models.push_back(&model);
+            instance_spheres.push_back(sphere);
+        });
+
+    const auto instances_count = static_cast<u32>(instance_spheres.size());
+    assert2(instances_count <= slots.allocator.capacity);
+
+    // order instances along a morton curve, so that every run of kCullWorkGroupSize instances is spatially compact
+    std::vector<u32> morton_codes(instances_count);
+    const vec3 scene_extent = glm::max(scene_max - scene_min, vec3(1e-6F));
+    for (u32 i = 0; i < instances_count; ++i)
+    {
+        const uvec3 cell = uvec3((vec3(instance_spheres[i]) - scene_min) / scene_extent * 1023.0F);
+        morton_codes[i] = (expand_morton_bits(cell.x) << 2) | (expand_morton_bits(cell.y) << 1)
+                        | expand_morton_bits(cell.z);
+    }
+
+    std::vector<u32> order(instances_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](u32 l, u32 r) { return morton_codes[l] < morton_codes[r]; });
+
+    constexpr u32 kClusterSize = shader_constants::kCullWorkGroupSize;
+    const u32 clusters_count   = (instances_count + kClusterSize - 1) / kClusterSize;
+
+    // gathered on the host first, the uploads are split by the staging buffer size
+    std::vector<transform_component> transforms(instances_count);
+    std::vector<static_model> static_models(instances_count);
+
+    // the clusters past the initial instances are empty until spawned instances get their slots
+    auto& clusters = clusters_data.host_clusters;
+    clusters.assign((slots.allocator.capacity + kClusterSize - 1) / kClusterSize, instance_cluster {.radius = -1.0F});
+    clusters_data.slot_spheres.assign(slots.allocator.capacity, kEmptySphere);
+
+    for (u32 i = 0; i < instances_count; ++i)
+    {
+        transforms[i]                 = *instance_transforms[order[i]];
+        static_models[i]              = *instance_models[order[i]];
+        clusters_data.slot_spheres[i] = instance_spheres[order[i]];
+    }
+
+    for (u32 c = 0; c < clusters_count; ++c)
+    {
+        fit_cluster(clusters_data, c);
+    }
+
+    // the allocator is empty, so the slots follow the morton order
+    for (u32 i = 0; i < instances_count; ++i)
+    {
+        const u32 slot = slots.allocator.allocate();
+        assert2(slot == i);
+
+        const u32 geometry_id = static_models[i].geometry_id;
+        if (geometry_id >= slots.geometry_instances.size())
+        {
+            slots.geometry_instances.resize(geometry_id + 1, 0);
+        }
+
+        slots.slot_geometry[slot] = geometry_id;
+        ++slots.geometry_instances[geometry_id];
+
+        scene.add_component<gpu_instance_component>(instance_entities[order[i]],
+                                                    gpu_instance_component {.index = slot});
+    }
+
+    render::upload_data(transfer, transform_buffer, transforms.data(), transforms.size());
+    render::upload_data(transfer, mesh_data_buffer, static_models.data(), static_models.size());
+    render::upload_data(transfer, clusters_data.clusters, clusters.data(), clusters.size());
+
+    clusters_data.clusters_count = clusters_count;
+}
+
+bool render::sync_instance_slots(const vk_scene_geometry_pool& geometry_pool, instance_slots_data& slots,
+                                 instance_clusters_data& clusters_data, const std::vector<u32>& bins_capacity,
+                                 const model_registry& scene_models, scene& scene)
+{
+    ZoneScoped;
+
+    slots.updates.clear();
+    slots.meshes.clear();
+    slots.dirty_clusters.clear();
+    slots.geometry_instances.resize(geometry_pool.geometry_count, 0);
+
+    constexpr u32 kClusterSize = shader_constants::kCullWorkGroupSize;
+
+    // the clusters of the released slots shrink to the instances left in them
+    for (const u32 slot : slots.released)
+    {
+        --slots.geometry_instances[slots.slot_geometry[slot]];
+        slots.allocator.free(slot);
+
+        clusters_data.slot_spheres[slot] = kEmptySphere;
+        slots.dirty_clusters.push_back(slot / kClusterSize);
+    }
+
+    // gathered first, the view excludes the component given to them below
+    slots.spawned.clear();
+    auto&& view = scene.get_view<transform_component, static_model_component>(entt::exclude<gpu_instance_component>);
+    slots.spawned.assign(view.begin(), view.end());
+
+    bool bins_overflow = false;
+    for (const entt::entity entity : slots.spawned)
+    {
+        const u32 slot = slots.allocator.allocate();
+        if (slot == render::gpu_slot_allocator::kInvalidSlot)
+        {
+            break;
+        }
+
+        const auto& tc    = scene.get_component<transform_component>(entity);
+        const auto& model = scene_models.get(scene.get_component<static_model_component>(entity).handle);
+        scene.add_component<gpu_instance_component>(entity, gpu_instance_component {.index = slot});
+
+        const u32 geometry_id     = model.geometry_id;
+        slots.slot_geometry[slot] = geometry_id;
+        ++slots.geometry_instances[geometry_id];
+
+        bins_overflow = bins_overflow || geometry_id >= bins_capacity.size()
+                     || slots.geometry_instances[geometry_id] > bins_capacity[geometry_id];
+
+        slots.updates.push_back(transform_update {.index = slot, .transform = tc});
+        slots.meshes.push_back(model);
+
+        clusters_data.slot_spheres[slot] = instance_sphere(tc, model);
+        slots.dirty_clusters.push_back(slot / kClusterSize);
+    }
+
+    // released slots no spawned entity took over are left with a mesh without lods, which the cull passes skip
+    for (const u32 slot : slots.released)
+    {
+        if (slots.allocator.is_free(slot))
+        {
+            slots.updates.push_back(transform_update {.index = slot});
+            slots.meshes.push_back(static_model {});
+        }
+    }
+
+    slots.released.clear();
+    clusters_data.clusters_count = (slots.allocator.slots_end + kClusterSize - 1) / kClusterSize;
+
+    return bins_overflow;
+}
+
+void render::upload_instance_updates(VkCommandBuffer cmd, const vk_renderer& renderer,
+                                     const vk_pipeline& scatter_pipeline, vk_mapped_buffer& updates_buffer,
+                                     const vk_buffer& meshes_transforms, const vk_buffer& meshes_data,
+                                     const vk_buffer& mesh_visibility_buffer, instance_clusters_data& clusters_data,
+                                     instance_slots_data& slots)
+{
+    ZoneScoped;
+
+    const auto updates_count = static_cast<u32>(slots.updates.size());
+    if (updates_count == 0)
+    {
+        return;
+    }
+
+    // the meshes follow the updates at an offset aligned for any minStorageBufferOffsetAlignment
+    constexpr u64 kOffsetAlignment = 256;
+
+    const u64 updates_size  = updates_count * sizeof(transform_update);
+    const u64 meshes_size   = updates_count * sizeof(static_model);
+    const u64 meshes_offset = (updates_size + kOffsetAlignment - 1) / kOffsetAlignment * kOffsetAlignment;
+
+    reserve_updates_buffer(renderer, updates_buffer, meshes_offset + meshes_size);
+
+    auto* mapped = static_cast<u8*>(updates_buffer.mapped);
+    std::memcpy(mapped, slots.updates.data(), updates_size);
+    std::memcpy(mapped + meshes_offset, slots.meshes.data(), meshes_size);
+
+    // the previous frame may still read the tables
+    render::cmd_stage_barrier(cmd,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                              0,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                              0);
+
+    refit_clusters(cmd, clusters_data, slots.dirty_clusters);
+
+    const render::vk_descriptor_info bindings[] = {
+        {updates_buffer.buffer, 0, updates_size},
+        meshes_transforms.buffer,
+        {updates_buffer.buffer, meshes_offset, meshes_size},
+        meshes_data.buffer,
+        mesh_visibility_buffer.buffer,
+    };
+    scatter_pipeline.bind(cmd);
+    scatter_pipeline.push_descriptor_set(cmd, bindings);
+    scatter_pipeline.push_constant(cmd, updates_count);
+    scatter_pipeline.dispatch(cmd, updates_count, 1, 1);
+
+    // the moved transforms are scattered into the same table next
+    render::cmd_stage_barrier(cmd,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                              VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+}
+
+void render::upload_dirty_transforms(VkCommandBuffer cmd, const vk_renderer& renderer,
+                                     const vk_pipeline& scatter_pipeline, vk_mapped_buffer& updates_buffer,
+                                     const vk_buffer& meshes_transforms, instance_clusters_data& clusters_data,
+                                     const model_registry& scene_models, scene& scene)
+{
+    ZoneScoped;
+
+    // the tag is set on any patched transform, only the instances have a slot to upload it to
+    const u64 dirty_count = scene.get_view<transform_dirty_tag>().size();
+    if (dirty_count == 0)
+    {
+        return;
+    }
+
+    reserve_updates_buffer(renderer, updates_buffer, dirty_count * sizeof(transform_update));
+
+    u32 updates_count = 0;
+    auto* updates     = static_cast<transform_update*>(updates_buffer.mapped);
+
+    constexpr u32 kClusterSize = shader_constants::kCullWorkGroupSize;
+    cpp::arena_vector<u32> dirty_clusters(renderer.get_frame_arena());
+
+    auto&& view =
+        scene.get_view<transform_dirty_tag, transform_component, static_model_component, gpu_instance_component>();
+    view.each(
+        [&](const transform_component& tc, const static_model_component& smc, const gpu_instance_component& gic)
+        {
+            updates[updates_count++] = transform_update {.index = gic.index, .transform = tc};
+
+            clusters_data.slot_spheres[gic.index] = instance_sphere(tc, scene_models.get(smc.handle));
+            dirty_clusters.push_back(gic.index / kClusterSize);
+        });
+
+    scene.clear_component<transform_dirty_tag>();
+    if (updates_count == 0)
+    {
+        return;
+    }
+
+    // the previous frame may still read the tables
+    render::cmd_stage_barrier(cmd,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                              0,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                              0);
+
+    refit_clusters(cmd, clusters_data, dirty_clusters);
+
+    const render::vk_descriptor_info bindings[] = {updates_buffer.buffer, meshes_transforms.buffer};
+    scatter_pipeline.bind(cmd);
+    scatter_pipeline.push_descriptor_set(cmd, bindings);
+    scatter_pipeline.push_constant(cmd, updates_count);
+    scatter_pipeline.dispatch(cmd, updates_count, 1, 1);
+
+    render::cmd_stage_barrier(cmd,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                              VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+}
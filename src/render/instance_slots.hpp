@@ -0,0 +1,139 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <render/gpu_slot_allocator.hpp>
+#include <render/model_registry.hpp>
+#include <render/platform/vk/vk_buffer.hpp>
+#include <render/platform/vk/vk_buffer_transfer.hpp>
+#include <render/platform/vk/vk_pipeline.hpp>
+#include <render/platform/vk/vk_renderer.hpp>
+#include <render/static_model.hpp>
+#include <scene/components.hpp>
+#include <scene/scene.hpp>
+
+#include <span>
+#include <vector>
+
+namespace render
+{
+    struct instance_cluster
+    {
+        vec3 center;
+        f32 radius;
+    };
+
+    // (slot, transform) pair scattered into the meshes transforms table, mirrors TransformUpdate in shaders/types.glsl
+    struct transform_update
+    {
+        u32 index;
+        u32 padding[3];
+        transform_component transform;
+    };
+
+    static_assert(sizeof(transform_update) == 48);
+
+    // Instances are uploaded in spatial order and grouped into clusters of one cull workgroup each, the cluster pass
+    // culls them first and the instance cull passes are dispatched indirectly over the survivors only
+    struct instance_clusters_data
+    {
+        vk_buffer clusters;          // bounding sphere of every cluster
+        vk_buffer visible_clusters;  // ids of the clusters that passed the cull
+        vk_buffer dispatch;          // VkDispatchIndirectCommand of the instance cull, followed by the scan state
+        u32 clusters_count {0};
+
+        std::vector<instance_cluster> host_clusters;  // refit on the host as instances move, see refit_clusters
+        std::vector<vec4> slot_spheres;               // world space sphere of the instance in every slot, empty if free
+    };
+
+    // Stable slots of the instances in the per-instance tables. Entities with a model and no gpu_instance_component
+    // are given a slot by sync_instance_slots, the slots of destroyed entities are collected by the component destroy
+    // signal and reused from the lowest one.
+    struct instance_slots_data
+    {
+        gpu_slot_allocator allocator;
+        std::vector<u32> released;            // slots of the entities destroyed since the last sync
+        std::vector<u32> slot_geometry;       // geometry id of the instance of every allocated slot
+        std::vector<u32> geometry_instances;  // instances with a slot per geometry id
+        std::vector<entt::entity> spawned;
+
+        // table updates of the last sync, parallel to each other, uploaded by upload_instance_updates
+        std::vector<transform_update> updates;
+        std::vector<static_model> meshes;
+        std::vector<u32> dirty_clusters;
+
+        explicit instance_slots_data(const u32 capacity)
+            : allocator(capacity)
+            , slot_geometry(capacity, 0)
+        {
+        }
+
+        void grow(const u32 capacity)
+        {
+            allocator.grow(capacity);
+            slot_geometry.resize(capacity, 0);
+        }
+
+        // slots taken once the released ones are freed and every entity waiting for a slot got one
+        [[nodiscard]] u32 required_slots(scene& scene) const
+        {
+            auto&& waiting =
+                scene.get_view<transform_component, static_model_component>(entt::exclude<gpu_instance_component>);
+            return allocator.live_count - static_cast<u32>(released.size())
+                 + static_cast<u32>(std::distance(waiting.begin(), waiting.end()));
+        }
+
+        void on_destroy(entt::registry& registry, const entt::entity entity)
+        {
+            released.push_back(registry.get<gpu_instance_component>(entity).index);
+        }
+    };
+
+    instance_clusters_data create_instance_clusters_data(const vk_renderer& renderer, u32 max_draws);
+
+    void destroy_instance_clusters_buffers(const vk_renderer& renderer, instance_clusters_data& clusters_data);
+
+    // Recreates the cluster buffers for capacity slots and uploads the host clusters again, the clusters past the
+    // previous capacity are empty. The buffers must not be in use.
+    void grow_instance_clusters(const vk_renderer& renderer, const vk_buffer_transfer& transfer,
+                                instance_clusters_data& clusters_data, u32 capacity);
+
+    // world space bounding sphere of an instance
+    vec4 instance_sphere(const transform_component& tc, const static_model& model);
+
+    // Fits the cluster sphere to the live slots of the cluster, so that it shrinks again once its instances move away
+    // or are released
+    void fit_cluster(instance_clusters_data& clusters_data, u32 cluster_index);
+
+    // fits the dirty clusters to their live slots and writes their spheres, has to be recorded after the previous
+    // frame's cluster cull
+    void refit_clusters(VkCommandBuffer cmd, instance_clusters_data& clusters_data, std::span<u32> dirty_clusters);
+
+    // Uploads every instance in the morton order and gives each entity its slot in the per-instance tables
+    void upload_draw_data(const vk_buffer_transfer& transfer, const vk_buffer& transform_buffer,
+                          const vk_buffer& mesh_data_buffer, instance_clusters_data& clusters_data,
+                          instance_slots_data& slots, const model_registry& scene_models, scene& scene);
+
+    // Releases the slots of the destroyed entities and assigns slots to the spawned ones, queueing their table updates
+    // for upload_instance_updates. The tables have to be grown to instance_slots_data::required_slots before, spawned
+    // entities left without a slot wait for the next sync. Returns true once a geometry has more instances than the
+    // ids bins_capacity reserves for it per instanced bin, the bins then have to be rebuilt.
+    bool sync_instance_slots(const vk_scene_geometry_pool& geometry_pool, instance_slots_data& slots,
+                             instance_clusters_data& clusters_data, const std::vector<u32>& bins_capacity,
+                             const model_registry& scene_models, scene& scene);
+
+    // Scatters the slot updates queued by sync_instance_slots into the per-instance tables and clears the visibility
+    // of the updated slots. Recorded before the cluster cull.
+    void upload_instance_updates(VkCommandBuffer cmd, const vk_renderer& renderer, const vk_pipeline& scatter_pipeline,
+                                 vk_mapped_buffer& updates_buffer, const vk_buffer& meshes_transforms,
+                                 const vk_buffer& meshes_data, const vk_buffer& mesh_visibility_buffer,
+                                 instance_clusters_data& clusters_data, instance_slots_data& slots);
+
+    // Writes the transforms patched since the last frame into the frame's updates buffer and scatters them into the
+    // meshes table, so the upload scales with what moved. The clusters of the moved instances are fit to their live
+    // slots again. Recorded before the cluster cull.
+    void upload_dirty_transforms(VkCommandBuffer cmd, const vk_renderer& renderer, const vk_pipeline& scatter_pipeline,
+                                 vk_mapped_buffer& updates_buffer, const vk_buffer& meshes_transforms,
+                                 instance_clusters_data& clusters_data, const model_registry& scene_models,
+                                 scene& scene);
+}
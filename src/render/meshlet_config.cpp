@@ -0,0 +1,113 @@
+#include <cpp/hash/hashed_string.hpp>
+#include <fs/fs.hpp>
+#include <render/meshlet_config.hpp>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+namespace
+{
+    constexpr u64 kMeshletBenchmarkMagic = "meshlet_benchmark"_hs;
+
+    struct meshlet_benchmark_record
+    {
+        u64 magic {kMeshletBenchmarkMagic};
+        u32 vendor_id {0};
+        u32 device_id {0};
+        u32 config_index {0};
+        u32 configs_count {render::kMeshletConfigsCount};  // invalidates records made with a different config list
+        f64 gpu_time_ms {0.0};
+    };
+
+    std::vector<meshlet_benchmark_record> load_records(const fs::path& path)
+    {
+        ZoneScoped;
+        std::vector<meshlet_benchmark_record> records;
+        if (!std::filesystem::exists(path.c_str()))
+        {
+            return records;
+        }
+
+        auto data = fs::read_file(path);
+        if (!data || data->size() % sizeof(meshlet_benchmark_record) != 0)
+        {
+            return records;
+        }
+
+        records.resize(data->size() / sizeof(meshlet_benchmark_record));
+        std::copy_n(data->get<u8>(), data->size(), reinterpret_cast<u8*>(records.data()));
+
+        std::erase_if(records,
+                      [](const meshlet_benchmark_record& record)
+                      {
+                          return record.magic != kMeshletBenchmarkMagic
+                              || record.configs_count != render::kMeshletConfigsCount
+                              || record.config_index >= render::kMeshletConfigsCount;
+                      });
+        return records;
+    }
+}
+
+fs::path render::meshlet_shader_path(u32 config_index, const char* name, const char* extension)
+{
+    const auto& config = kMeshletConfigs[config_index];
+    return fs::path_string::make_formatted("../shaders/bin/%s_v%u_t%u_ts%u_ms%u.%s.spv",
+                                           name,
+                                           config.max_vertices,
+                                           config.max_triangles,
+                                           config.task_work_group_size,
+                                           config.mesh_work_group_size,
+                                           extension);
+}
+
+u32 render::load_meshlet_config_index(const fs::path& path, u32 vendor_id, u32 device_id)
+{
+    ZoneScoped;
+    for (const auto& record : load_records(path))
+    {
+        if (record.vendor_id == vendor_id && record.device_id == device_id)
+        {
+            return record.config_index;
+        }
+    }
+
+    return 0;
+}
+
+void render::record_meshlet_benchmark(const fs::path& path, u32 vendor_id, u32 device_id, u32 config_index,
+                                      f64 gpu_time_ms, bool new_sweep)
+{
+    ZoneScoped;
+    auto records = load_records(path);
+
+    const meshlet_benchmark_record new_record {
+        .vendor_id    = vendor_id,
+        .device_id    = device_id,
+        .config_index = config_index,
+        .gpu_time_ms  = gpu_time_ms,
+    };
+
+    auto it = std::find_if(records.begin(),
+                           records.end(),
+                           [&](const meshlet_benchmark_record& record)
+                           {
+                               return record.vendor_id == vendor_id && record.device_id == device_id;
+                           });
+
+    if (it == records.end())
+    {
+        records.push_back(new_record);
+    }
+    else if (new_sweep || gpu_time_ms < it->gpu_time_ms)
+    {
+        *it = new_record;
+    }
+    else
+    {
+        return;
+    }
+
+    fs::write_file(path, bytes(records.size() * sizeof(meshlet_benchmark_record), records.data()));
+}
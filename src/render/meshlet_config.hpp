@@ -0,0 +1,46 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <fs/path.hpp>
+#include <shaders/constants.h>
+
+namespace render
+{
+    struct meshlet_config
+    {
+        u32 max_vertices;
+        u32 max_triangles;
+        u32 task_work_group_size;
+        u32 mesh_work_group_size;
+    };
+
+    // Every entry has a matching set of meshlet shader variants in shaders/shaders.cfg, named by meshlet_shader_path.
+    // The first one is the default and mirrors shaders/include/shaders/constants.h.
+    inline constexpr meshlet_config kMeshletConfigs[] = {
+        { 64,  96, 32,  32},
+        { 64, 124, 32,  32},
+        {128, 128, 32,  64},
+        {128, 252, 64, 128},
+    };
+
+    inline constexpr u32 kMeshletConfigsCount = sizeof(kMeshletConfigs) / sizeof(kMeshletConfigs[0]);
+
+    // written by the meshlet benchmark target, read by the renderer at startup
+    inline constexpr fs::path kMeshletBenchmarkRecordPath = ".meshlet_benchmark";
+
+    static_assert(kMeshletConfigs[0].max_vertices == shader_constants::kMaxVerticesPerMeshlet);
+    static_assert(kMeshletConfigs[0].max_triangles == shader_constants::kMaxTrianglesPerMeshlet);
+    static_assert(kMeshletConfigs[0].task_work_group_size == shader_constants::kTaskWorkGroups);
+    static_assert(kMeshletConfigs[0].mesh_work_group_size == shader_constants::kMeshWorkGroups);
+
+    // e.g. "../shaders/bin/meshlets_v64_t96_ts32_ms32.mesh.spv" for name "meshlets" and extension "mesh"
+    fs::path meshlet_shader_path(u32 config_index, const char* name, const char* extension);
+
+    // index of the fastest config recorded for the device by the meshlet benchmark, 0 if there is none
+    u32 load_meshlet_config_index(const fs::path& path, u32 vendor_id, u32 device_id);
+
+    // keeps the record if it starts a new sweep, is the first one for the device or beats the recorded one
+    void record_meshlet_benchmark(const fs::path& path, u32 vendor_id, u32 device_id, u32 config_index,
+                                  f64 gpu_time_ms, bool new_sweep);
+}
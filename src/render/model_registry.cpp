@@ -0,0 +1,132 @@
+#include <render/model_registry.hpp>
+
+#include <assert2.hpp>
+#include <cpp/hash/crc_hash.hpp>
+#include <fs/fs.hpp>
+#include <tracy/Tracy.hpp>
+
+u32 render::model_registry::add(const static_model& model, const source& origin)
+{
+    ZoneScoped;
+
+    u32 handle = 0;
+    if (free_handles.empty())
+    {
+        handle = static_cast<u32>(records.size());
+        records.emplace_back();
+    }
+    else
+    {
+        handle = free_handles.back();
+        free_handles.pop_back();
+    }
+
+    records[handle] = record {.model = model, .origin = origin, .references = 0, .loaded = true};
+    return handle;
+}
+
+result<std::vector<u32>> render::model_registry::load(const fs::path& path, vk_scene_geometry_pool& geometry_pool,
+                                                      cpp::job_system& jobs)
+{
+    ZoneScoped;
+
+    const auto file = fs::read_file(path);
+    if (!file)
+    {
+        return file.message;
+    }
+
+    const u64 content_hash = cpp::crc::crc64(file->get<char>(), file->size());
+
+    std::vector<u32> handles;
+    for (u32 mesh = 0;; ++mesh)
+    {
+        const u32 handle = find(content_hash, mesh);
+        if (handle == kInvalidHandle)
+        {
+            break;
+        }
+
+        handles.push_back(handle);
+    }
+
+    if (!handles.empty())
+    {
+        return handles;
+    }
+
+    auto models = static_model::load(path, geometry_pool, jobs);
+    if (!models)
+    {
+        return models.message;
+    }
+
+    for (u32 mesh = 0; mesh < models->size(); ++mesh)
+    {
+        handles.push_back(
+            add((*models)[mesh], source {.path = path, .content_hash = content_hash, .mesh_index = mesh}));
+    }
+
+    return handles;
+}
+
+u32 render::model_registry::find(const u64 content_hash, const u32 mesh_index) const
+{
+    for (u32 handle = 0; handle < records.size(); ++handle)
+    {
+        const auto& origin = records[handle].origin;
+        if (records[handle].loaded && origin.content_hash == content_hash && origin.mesh_index == mesh_index)
+        {
+            return handle;
+        }
+    }
+
+    return kInvalidHandle;
+}
+
+void render::model_registry::acquire(const u32 handle)
+{
+    assert2(handle < records.size() && records[handle].loaded);
+    ++records[handle].references;
+}
+
+void render::model_registry::release(const u32 handle)
+{
+    assert2(handle < records.size() && records[handle].references > 0);
+    --records[handle].references;
+}
+
+void render::model_registry::relocate(const std::vector<vk_geometry_relocation>& relocations)
+{
+    ZoneScoped;
+
+    for (auto& record : records)
+    {
+        if (record.loaded)
+        {
+            record.model.relocate(relocations[record.model.geometry_id]);
+        }
+    }
+}
+
+u32 render::model_registry::unload_unreferenced(vk_scene_geometry_pool& geometry_pool)
+{
+    ZoneScoped;
+
+    u32 unloaded = 0;
+    for (u32 handle = 0; handle < records.size(); ++handle)
+    {
+        auto& record = records[handle];
+        if (!record.loaded || record.references > 0)
+        {
+            continue;
+        }
+
+        static_model::unload(record.model, geometry_pool);
+        record.loaded = false;
+        free_handles.push_back(handle);
+        ++unloaded;
+    }
+
+    return unloaded;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <fs/path.hpp>
+#include <render/platform/vk/vk_geometry_pool.hpp>
+#include <render/static_model.hpp>
+#include <result.hpp>
+
+#include <limits>
+#include <vector>
+
+namespace render
+{
+    // Owns the static_model records the instances share, components reference them by a compact handle instead of
+    // holding a copy. Handles of unloaded models are reused.
+    struct model_registry
+    {
+        static constexpr u32 kInvalidHandle = std::numeric_limits<u32>::max();
+
+        // file a model was loaded from, scenes reference the models by content hash and mesh index
+        struct source
+        {
+            fs::path path;
+            u64 content_hash {0};  // crc64 of the file the model and its cache were built from
+            u32 mesh_index {0};
+        };
+
+        struct record
+        {
+            static_model model;
+            source origin;
+            u32 references {0};  // instances referencing the model
+            bool loaded {false};
+        };
+
+        std::vector<record> records;  // indexed by handle
+        std::vector<u32> free_handles;
+
+        u32 add(const static_model& model, const source& origin = {});
+
+        // Handles of every mesh of the file, in file order. The meshes are loaded once per file content, loading a
+        // file with the content of an already loaded one returns the handles of its records.
+        result<std::vector<u32>> load(const fs::path& path, vk_scene_geometry_pool& geometry_pool,
+                                      cpp::job_system& jobs);
+
+        // kInvalidHandle if no loaded model comes from that mesh
+        [[nodiscard]] u32 find(u64 content_hash, u32 mesh_index) const;
+
+        [[nodiscard]] const static_model& get(const u32 handle) const
+        {
+            return records[handle].model;
+        }
+
+        void acquire(u32 handle);
+
+        void release(u32 handle);
+
+        // patches every loaded model after the pool moved their geometry
+        void relocate(const std::vector<vk_geometry_relocation>& relocations);
+
+        // Frees the geometry of the loaded models no instance references, returns how many were unloaded. The meshes
+        // table must not reference them by then.
+        u32 unload_unreferenced(vk_scene_geometry_pool& geometry_pool);
+    };
+}
@@ -9,6 +9,16 @@ void render::destroy_buffer(VmaAllocator allocator, vk_buffer& buffer)
     vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
 }
 
+void render::destroy_buffer(VmaAllocator allocator, vk_mapped_buffer& buffer)
+{
+    ZoneScoped;
+    vmaUnmapMemory(allocator, buffer.allocation);
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+
+    buffer.size   = 0;
+    buffer.mapped = nullptr;
+}
+
 result<render::vk_buffer> render::create_buffer(u64 size, VkBufferUsageFlags usage, VmaAllocator allocator,
                                                 VmaAllocationCreateFlags allocation_flags)
 {
@@ -28,7 +38,7 @@ result<render::vk_buffer> render::create_buffer(const VkBufferCreateInfo& buffer
 {
     ZoneScoped;
 
-    vk_buffer result {.size = buffer_create_info.size};
+    vk_buffer result {.size = buffer_create_info.size, .usage = buffer_create_info.usage};
     const VmaAllocationCreateInfo alloc_info = {.flags = allocation_flags, .usage = VMA_MEMORY_USAGE_AUTO};
     VK_RETURN_ON_FAIL(
         vmaCreateBuffer(allocator, &buffer_create_info, &alloc_info, &result.buffer, &result.allocation, nullptr));
@@ -12,6 +12,7 @@ namespace render
         u64 size {0};
         VkBuffer buffer {VK_NULL_HANDLE};
         VmaAllocation allocation {VK_NULL_HANDLE};
+        VkBufferUsageFlags usage {0};  // kept to reallocate the buffer when it grows
     };
 
     struct vk_mapped_buffer
@@ -24,6 +25,8 @@ namespace render
 
     void destroy_buffer(VmaAllocator allocator, vk_buffer& buffer);
 
+    void destroy_buffer(VmaAllocator allocator, vk_mapped_buffer& buffer);
+
     result<vk_buffer> create_buffer(u64 size, VkBufferUsageFlags usage, VmaAllocator allocator,
                                     VmaAllocationCreateFlags allocation_flags);
 
@@ -1,6 +1,7 @@
 #include <assert2.hpp>
 #include <render/platform/vk/vk_buffer_transfer.hpp>
 
+#include <algorithm>
 #include <cstring>
 
 result<render::vk_buffer_transfer> render::create_buffer_transfer(VkDevice device, VmaAllocator allocator,
@@ -26,7 +27,13 @@ result<render::vk_buffer_transfer> render::create_buffer_transfer(VkDevice devic
     vmaMapMemory(allocator, staging_buffer->allocation, &data);
 
     return vk_buffer_transfer {
-        .mapped = data, .queue = queue, .staging_buffer = *staging_buffer, .staging_command_buffer = *cmd_buffer};
+        .mapped                 = data,
+        .queue                  = queue,
+        .staging_buffer         = *staging_buffer,
+        .staging_command_buffer = *cmd_buffer,
+        .device                 = device,
+        .allocator              = allocator,
+    };
 }
 
 void render::destroy_buffer_transfer(VkDevice device, VmaAllocator allocator, vk_buffer_transfer& buffer_transfer)
@@ -38,6 +45,30 @@ void render::destroy_buffer_transfer(VkDevice device, VmaAllocator allocator, vk
     render::destroy_command_buffer(device, buffer_transfer.staging_command_buffer);
 }
 
+namespace
+{
+    void submit_copy(const render::vk_buffer_transfer& transfer, VkBuffer src, VkBuffer dst, const VkBufferCopy& region)
+    {
+        VkCommandBufferBeginInfo begin_info {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+
+        vkBeginCommandBuffer(transfer.staging_command_buffer.cmd_buffer, &begin_info);
+        vkCmdCopyBuffer(transfer.staging_command_buffer.cmd_buffer, src, dst, 1, &region);
+        vkEndCommandBuffer(transfer.staging_command_buffer.cmd_buffer);
+
+        VkSubmitInfo submit_info {
+            .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers    = &transfer.staging_command_buffer.cmd_buffer,
+        };
+
+        vkQueueSubmit(transfer.queue.queue, 1, &submit_info, VK_NULL_HANDLE);
+        vkQueueWaitIdle(transfer.queue.queue);
+    }
+}
+
 void render::submit_transfer(const vk_buffer_transfer& transfer, const vk_buffer& dst, const VkBufferCopy& region)
 {
     ZoneScoped;
@@ -45,36 +76,83 @@ void render::submit_transfer(const vk_buffer_transfer& transfer, const vk_buffer
     assert2(region.dstOffset + region.size <= dst.size);
     assert2(region.srcOffset + region.size <= transfer.staging_buffer.size);
 
-    VkCommandBufferBeginInfo begin_info {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    };
+    submit_copy(transfer, transfer.staging_buffer.buffer, dst.buffer, region);
+}
+
+void render::copy_buffer(const vk_buffer_transfer& transfer, const vk_buffer& src, const vk_buffer& dst,
+                         const VkBufferCopy& region)
+{
+    ZoneScoped;
 
-    vkBeginCommandBuffer(transfer.staging_command_buffer.cmd_buffer, &begin_info);
-    vkCmdCopyBuffer(transfer.staging_command_buffer.cmd_buffer, transfer.staging_buffer.buffer, dst.buffer, 1, &region);
-    vkEndCommandBuffer(transfer.staging_command_buffer.cmd_buffer);
+    assert2(region.srcOffset + region.size <= src.size);
+    assert2(region.dstOffset + region.size <= dst.size);
 
-    VkSubmitInfo submit_info {
-        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers    = &transfer.staging_command_buffer.cmd_buffer,
-    };
+    submit_copy(transfer, src.buffer, dst.buffer, region);
+}
+
+u64 render::grow_capacity(const u64 capacity, const u64 required)
+{
+    return std::max(required, capacity + capacity / 2);
+}
+
+result<bool> render::reserve_buffer(const vk_buffer_transfer& transfer, vk_buffer& buffer, const u64 required_size)
+{
+    ZoneScoped;
+
+    if (required_size <= buffer.size)
+    {
+        return false;
+    }
+
+    assert2(buffer.size == 0 || (buffer.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) != 0);
+    const auto grown = render::create_buffer(grow_capacity(buffer.size, required_size),
+                                             buffer.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                             transfer.allocator,
+                                             0);
+    if (!grown)
+    {
+        return grown.message;
+    }
+
+    // frames in flight may still read or write the previous buffer
+    vkDeviceWaitIdle(transfer.device);
+
+    if (buffer.size > 0)
+    {
+        copy_buffer(transfer, buffer, *grown, VkBufferCopy {.size = buffer.size});
+        render::destroy_buffer(transfer.allocator, buffer);
+    }
 
-    vkQueueSubmit(transfer.queue.queue, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(transfer.queue.queue);
+    buffer = *grown;
+    return true;
 }
 
 void render::fill_buffer(const vk_buffer_transfer& transfer, const vk_buffer& dst, const u8* value_ptr, u64 value_size,
                          const VkBufferCopy& region)
 {
+    ZoneScoped;
+
     assert2((region.size % value_size) == 0);
-    const u64 count = region.size / value_size;
+    assert2(value_size <= transfer.staging_buffer.size - region.srcOffset);
 
-    for (u32 i = 0; i < count; i++)
+    // the pattern is written to the staging buffer once, larger regions copy it repeatedly
+    const u64 staging_size = (transfer.staging_buffer.size - region.srcOffset) / value_size * value_size;
+    const u64 chunk_size   = std::min(region.size, staging_size);
+    const u64 count        = chunk_size / value_size;
+
+    for (u64 i = 0; i < count; i++)
     {
         std::memcpy(static_cast<u8*>(transfer.mapped) + region.srcOffset + value_size * i, value_ptr, value_size);
     }
-    submit_transfer(transfer, dst, region);
+
+    for (u64 filled = 0; filled < region.size; filled += chunk_size)
+    {
+        submit_transfer(transfer,
+                        dst,
+                        VkBufferCopy {.srcOffset = region.srcOffset,
+                                      .dstOffset = region.dstOffset + filled,
+                                      .size      = std::min(chunk_size, region.size - filled)});
+    }
 }
 
 void render::upload_data(const vk_buffer_transfer& transfer, const vk_buffer& dst, const u8* data,
@@ -83,7 +161,16 @@ void render::upload_data(const vk_buffer_transfer& transfer, const vk_buffer& ds
     ZoneScoped;
 
     assert2(data != nullptr);
-    assert2(region.size <= transfer.staging_buffer.size - region.srcOffset);
-    std::copy_n(data, region.size, (static_cast<u8*>(transfer.mapped)) + region.srcOffset);
-    submit_transfer(transfer, dst, region);
+    assert2(region.srcOffset < transfer.staging_buffer.size);
+
+    const u64 chunk_size = transfer.staging_buffer.size - region.srcOffset;
+    for (u64 uploaded = 0; uploaded < region.size; uploaded += chunk_size)
+    {
+        const u64 size = std::min(chunk_size, region.size - uploaded);
+        std::copy_n(data + uploaded, size, static_cast<u8*>(transfer.mapped) + region.srcOffset);
+        submit_transfer(transfer,
+                        dst,
+                        VkBufferCopy {
+                            .srcOffset = region.srcOffset, .dstOffset = region.dstOffset + uploaded, .size = size});
+    }
 }
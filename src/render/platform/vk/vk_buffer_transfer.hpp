@@ -16,6 +16,9 @@ namespace render
         queue_data queue;
         vk_buffer staging_buffer;
         vk_command_buffer staging_command_buffer;
+
+        VkDevice device {VK_NULL_HANDLE};
+        VmaAllocator allocator {VK_NULL_HANDLE};
     };
 
     result<vk_buffer_transfer> create_buffer_transfer(VkDevice device, VmaAllocator allocator, const queue_data& queue,
@@ -25,6 +28,18 @@ namespace render
 
     void submit_transfer(const vk_buffer_transfer& transfer, const vk_buffer& dst, const VkBufferCopy& region);
 
+    void copy_buffer(const vk_buffer_transfer& transfer, const vk_buffer& src, const vk_buffer& dst,
+                     const VkBufferCopy& region);
+
+    // capacity policy of growable buffers: the required size, but at least one and a half times the current one
+    u64 grow_capacity(u64 capacity, u64 required);
+
+    // Reallocates the buffer with the same usage if it is smaller than required_size, keeping its contents. The
+    // usage has to include VK_BUFFER_USAGE_TRANSFER_SRC_BIT. Waits for the device to go idle when it reallocates,
+    // returns whether it did.
+    result<bool> reserve_buffer(const vk_buffer_transfer& transfer, vk_buffer& buffer, u64 required_size);
+
+    // uploads larger than the staging buffer are split into several transfers
     void upload_data(const vk_buffer_transfer& transfer, const vk_buffer& dst, const u8* data,
                      const VkBufferCopy& region);
 
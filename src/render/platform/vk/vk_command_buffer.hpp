@@ -19,4 +19,37 @@ namespace render
         VkCommandPoolCreateFlags extra_flags = 0);
 
     void destroy_command_buffer(VkDevice device, const vk_command_buffer& cmd_buffer);
+
+    // records a one-off command buffer, submits it to the queue and waits for it to finish
+    template<typename Record>
+    result<bool> submit_once(VkDevice device, VkQueue queue, u32 queue_family, Record&& record)
+    {
+        auto cmd_buffer = create_command_buffer(device, queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        if (!cmd_buffer)
+        {
+            return cmd_buffer.message;
+        }
+
+        VkCommandBuffer cmd = cmd_buffer->cmd_buffer;
+
+        const VkCommandBufferBeginInfo begin_info {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        vkBeginCommandBuffer(cmd, &begin_info);
+        record(cmd);
+        vkEndCommandBuffer(cmd);
+
+        const VkSubmitInfo submit_info {
+            .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers    = &cmd,
+        };
+
+        vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+        vkQueueWaitIdle(queue);
+
+        destroy_command_buffer(device, *cmd_buffer);
+        return true;
+    }
 }
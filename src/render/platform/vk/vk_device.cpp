@@ -366,6 +366,7 @@ bool check_device_basic_features_support(VkPhysicalDevice device, VkSurfaceKHR s
                                  vk13_features.maintenance4 && mesh_features.meshShader && mesh_features.taskShader);
     features_table.set_supported(rendering_features_table::eDrawIndirect,
                                  vk12_features.drawIndirectCount && device_features2.features.multiDrawIndirect
+                                     && device_features2.features.drawIndirectFirstInstance
                                      && vk11_features.shaderDrawParameters);
     features_table.set_supported(rendering_features_table::ePipelineStats,
                                  device_features2.features.pipelineStatisticsQuery);
@@ -531,8 +532,9 @@ VkResult create_vulkan_device(const rendering_features_table& rendering_features
         .sType    = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
         .pNext    = &vk11_features,
         .features = {
-                     .multiDrawIndirect       = rendering_features.wanted(rendering_features_table::eDrawIndirect),
-                     .pipelineStatisticsQuery = rendering_features.wanted(rendering_features_table::ePipelineStats),
+                     .multiDrawIndirect         = rendering_features.wanted(rendering_features_table::eDrawIndirect),
+                     .drawIndirectFirstInstance = rendering_features.wanted(rendering_features_table::eDrawIndirect),
+                     .pipelineStatisticsQuery   = rendering_features.wanted(rendering_features_table::ePipelineStats),
                      }
     };
 
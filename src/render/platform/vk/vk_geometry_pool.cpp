@@ -0,0 +1,631 @@
+#include <assert2.hpp>
+#include <render/platform/vk/vk_barrier.hpp>
+#include <render/platform/vk/vk_geometry_pool.hpp>
+#include <render/static_model.hpp>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    // copies of a pool through the scratch buffer, the source and destination ranges of a move may overlap
+    struct pool_moves
+    {
+        std::vector<VkBufferCopy> to_scratch;
+        std::vector<VkBufferCopy> from_scratch;
+    };
+
+    // packs the given ranges towards the start of the pool in their current order and leaves a single free range
+    pool_moves compact_pool(render::vk_shared_buffer& pool, std::vector<render::vk_shared_range*>& ranges,
+                            u64& scratch_offset)
+    {
+        ZoneScoped;
+        std::sort(ranges.begin(),
+                  ranges.end(),
+                  [](const render::vk_shared_range* l, const render::vk_shared_range* r)
+                  {
+                      return l->offset < r->offset;
+                  });
+
+        pool_moves moves;
+        u64 cursor = 0;
+        for (render::vk_shared_range* range : ranges)
+        {
+            if (range->offset != cursor)
+            {
+                moves.to_scratch.push_back(
+                    VkBufferCopy {.srcOffset = range->offset, .dstOffset = scratch_offset, .size = range->size});
+                moves.from_scratch.push_back(
+                    VkBufferCopy {.srcOffset = scratch_offset, .dstOffset = cursor, .size = range->size});
+
+                scratch_offset += range->size;
+                range->offset = cursor;
+            }
+
+            cursor += range->size;
+        }
+
+        pool.free_ranges.clear();
+        if (cursor < pool.size)
+        {
+            pool.free_ranges.push_back(render::vk_shared_range {.offset = cursor, .size = pool.size - cursor});
+        }
+
+        return moves;
+    }
+
+    i32 range_delta(const render::vk_shared_range& from, const render::vk_shared_range& to, u64 element_size)
+    {
+        const i64 delta = static_cast<i64>(to.offset / element_size) - static_cast<i64>(from.offset / element_size);
+        return static_cast<i32>(delta);
+    }
+
+    // records a one-off command buffer on the graphics queue, submits it and waits for it to finish
+    template<typename Record>
+    result<bool> submit_once(const render::vk_renderer& renderer, Record&& record)
+    {
+        ZoneScoped;
+
+        const auto& context             = renderer.get_context();
+        const render::queue_data& queue = context.queues[render::queue_kind::eGfx];
+        return render::submit_once(context.device, queue.queue, queue.family, std::forward<Record>(record));
+    }
+
+    result<render::vk_buffer> upload_relocations(const render::vk_renderer& renderer,
+                                                 const render::vk_scene_geometry_pool& pool,
+                                                 const std::vector<render::vk_geometry_relocation>& relocations)
+    {
+        auto relocations_buffer =
+            render::create_buffer(relocations.size() * sizeof(render::vk_geometry_relocation),
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  renderer.get_context().allocator,
+                                  0);
+        if (relocations_buffer)
+        {
+            render::upload_data(pool.transfer, *relocations_buffer, relocations.data(), relocations.size());
+        }
+
+        return relocations_buffer;
+    }
+
+    void cmd_relocate_meshes(VkCommandBuffer cmd, const render::vk_pipeline& relocate_meshes,
+                             const render::vk_buffer& meshes_data, const render::vk_buffer& relocations_buffer,
+                             u32 meshes_count)
+    {
+        const render::vk_descriptor_info bindings[] = {meshes_data.buffer, relocations_buffer.buffer};
+        relocate_meshes.bind(cmd);
+        relocate_meshes.push_descriptor_set(cmd, bindings);
+        relocate_meshes.push_constant(cmd, meshes_count);
+        relocate_meshes.dispatch(cmd, meshes_count, 1, 1);
+    }
+}
+
+result<render::vk_shared_range> render::vk_shared_buffer::allocate(u64 bytes, u64 alignment)
+{
+    if (bytes == 0)
+    {
+        return vk_shared_range {};
+    }
+
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+    {
+        const u64 offset = (it->offset + alignment - 1) / alignment * alignment;
+        const u64 end    = it->offset + it->size;
+        if (offset + bytes > end)
+        {
+            continue;
+        }
+
+        const vk_shared_range head {.offset = it->offset, .size = offset - it->offset};
+        const vk_shared_range tail {.offset = offset + bytes, .size = end - offset - bytes};
+
+        it = free_ranges.erase(it);
+        if (tail.size > 0)
+        {
+            it = free_ranges.insert(it, tail);
+        }
+        if (head.size > 0)
+        {
+            free_ranges.insert(it, head);
+        }
+
+        used += bytes;
+        return vk_shared_range {.offset = offset, .size = bytes};
+    }
+
+    return "shared buffer is out of memory";
+}
+
+void render::vk_shared_buffer::free(const vk_shared_range& range)
+{
+    if (range.size == 0)
+    {
+        return;
+    }
+
+    assert2(used >= range.size);
+    used -= range.size;
+
+    auto next = std::lower_bound(free_ranges.begin(),
+                                 free_ranges.end(),
+                                 range.offset,
+                                 [](const vk_shared_range& free_range, u64 offset)
+                                 {
+                                     return free_range.offset < offset;
+                                 });
+
+    assert2(next == free_ranges.end() || range.offset + range.size <= next->offset);
+    auto it = free_ranges.insert(next, range);
+
+    if (auto after = std::next(it); after != free_ranges.end() && it->offset + it->size == after->offset)
+    {
+        it->size += after->size;
+        free_ranges.erase(after);
+    }
+
+    if (it != free_ranges.begin())
+    {
+        if (auto before = std::prev(it); before->offset + before->size == it->offset)
+        {
+            before->size += it->size;
+            free_ranges.erase(it);
+        }
+    }
+}
+
+u64 render::vk_shared_buffer::largest_free_range() const
+{
+    u64 largest = 0;
+    for (const auto& range : free_ranges)
+    {
+        largest = std::max(largest, range.size);
+    }
+
+    return largest;
+}
+
+bool render::vk_shared_buffer::grow(const vk_buffer_transfer& transfer, u64 min_free_bytes)
+{
+    ZoneScoped;
+
+    // by half of the current size at least, so that pools created in proportion keep it
+    const auto grown = render::reserve_buffer(transfer, buffer, size + std::max(size / 2, min_free_bytes));
+    if (!grown || !*grown)
+    {
+        return false;
+    }
+
+    const vk_shared_range tail {.offset = size, .size = buffer.size - size};
+    if (!free_ranges.empty() && free_ranges.back().offset + free_ranges.back().size == tail.offset)
+    {
+        free_ranges.back().size += tail.size;
+    }
+    else
+    {
+        free_ranges.push_back(tail);
+    }
+
+    size = buffer.size;
+    return true;
+}
+
+result<render::vk_shared_range> render::vk_shared_buffer::allocate_or_grow(const vk_buffer_transfer& transfer,
+                                                                           u64 bytes, u64 alignment)
+{
+    auto range = allocate(bytes, alignment);
+    if (!range && grow(transfer, bytes + alignment))
+    {
+        range = allocate(bytes, alignment);
+    }
+
+    return range;
+}
+
+u32 render::add_geometry(vk_scene_geometry_pool& pool, const vk_geometry_allocation& allocation,
+                         vk_geometry_host_data&& host_data)
+{
+    if (!pool.free_geometry_ids.empty())
+    {
+        const u32 geometry_id = pool.free_geometry_ids.back();
+        pool.free_geometry_ids.pop_back();
+
+        pool.geometries[geometry_id]      = allocation;
+        pool.host_geometries[geometry_id] = std::move(host_data);
+        return geometry_id;
+    }
+
+    pool.geometries.push_back(allocation);
+    pool.host_geometries.push_back(std::move(host_data));
+    assert2(pool.geometries.size() == pool.geometry_count + 1);
+
+    return pool.geometry_count++;
+}
+
+void render::free_geometry(vk_scene_geometry_pool& pool, u32 geometry_id)
+{
+    ZoneScoped;
+    assert2(geometry_id < pool.geometries.size());
+
+    auto& geometry = pool.geometries[geometry_id];
+    if (!geometry.resident)
+    {
+        return;
+    }
+
+    pool.index.free(geometry.index);
+    pool.index16.free(geometry.index16);
+    pool.position.free(geometry.position);
+    pool.attribute.free(geometry.attribute);
+    pool.meshlets.free(geometry.meshlets);
+    pool.meshlets_payload.free(geometry.meshlets_payload);
+
+    geometry                          = vk_geometry_allocation {};
+    pool.host_geometries[geometry_id] = vk_geometry_host_data {};
+    pool.free_geometry_ids.push_back(geometry_id);
+}
+
+result<std::vector<render::vk_geometry_relocation>> render::defragment_geometry_pool(
+    const vk_renderer& renderer, vk_scene_geometry_pool& pool, const vk_pipeline& relocate_meshes,
+    const vk_pipeline& relocate_meshlets, const vk_buffer& meshes_data, u32 meshes_count)
+{
+    ZoneScoped;
+
+    const std::vector<vk_geometry_allocation> previous = pool.geometries;
+
+    vk_shared_buffer* pools[] = {
+        &pool.index, &pool.index16, &pool.position, &pool.attribute, &pool.meshlets, &pool.meshlets_payload};
+    vk_shared_range vk_geometry_allocation::* members[] = {&vk_geometry_allocation::index,
+                                                          &vk_geometry_allocation::index16,
+                                                          &vk_geometry_allocation::position,
+                                                          &vk_geometry_allocation::attribute,
+                                                          &vk_geometry_allocation::meshlets,
+                                                          &vk_geometry_allocation::meshlets_payload};
+
+    // the compaction is planned on the cpu copies first, restored if the moves cannot be recorded
+    std::vector<vk_shared_range> previous_free_ranges[COUNT_OF(pools)];
+    auto restore_pools = [&]
+    {
+        pool.geometries = previous;
+        for (u32 p = 0; p < COUNT_OF(pools); ++p)
+        {
+            pools[p]->free_ranges = std::move(previous_free_ranges[p]);
+        }
+    };
+
+    u64 scratch_size = 0;
+    pool_moves moves[COUNT_OF(pools)];
+    for (u32 p = 0; p < COUNT_OF(pools); ++p)
+    {
+        previous_free_ranges[p] = pools[p]->free_ranges;
+
+        std::vector<vk_shared_range*> ranges;
+        for (auto& geometry : pool.geometries)
+        {
+            if (geometry.resident && (geometry.*members[p]).size > 0)
+            {
+                ranges.push_back(&(geometry.*members[p]));
+            }
+        }
+
+        moves[p] = compact_pool(*pools[p], ranges, scratch_size);
+    }
+
+    u32 max_meshlets_count = 0;
+    bool payload_moved     = false;
+    std::vector<vk_geometry_relocation> relocations(pool.geometries.size());
+    for (u32 g = 0; g < pool.geometries.size(); ++g)
+    {
+        const auto& from = previous[g];
+        const auto& to   = pool.geometries[g];
+        if (!to.resident)
+        {
+            continue;
+        }
+
+        relocations[g] = vk_geometry_relocation {
+            .vertex_delta   = range_delta(from.position, to.position, sizeof(static_model::packed_position)),
+            .index_delta    = range_delta(from.index, to.index, sizeof(u32)),
+            .index16_delta  = range_delta(from.index16, to.index16, sizeof(u16)),
+            .meshlet_delta  = range_delta(from.meshlets, to.meshlets, sizeof(static_model::meshlet)),
+            .payload_delta  = range_delta(from.meshlets_payload, to.meshlets_payload, 1),
+            .base_meshlet   = static_cast<u32>(to.meshlets.offset / sizeof(static_model::meshlet)),
+            .meshlets_count = static_cast<u32>(to.meshlets.size / sizeof(static_model::meshlet)),
+        };
+
+        max_meshlets_count = std::max(max_meshlets_count, relocations[g].meshlets_count);
+        payload_moved      = payload_moved || relocations[g].payload_delta != 0;
+    }
+
+    if (scratch_size == 0)
+    {
+        return relocations;
+    }
+
+    const auto& context = renderer.get_context();
+
+    // frames in flight may still read the pools
+    vkDeviceWaitIdle(context.device);
+
+    auto scratch = render::create_buffer(
+        scratch_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, context.allocator, 0);
+    if (!scratch)
+    {
+        restore_pools();
+        return scratch.message;
+    }
+
+    auto relocations_buffer = upload_relocations(renderer, pool, relocations);
+    if (!relocations_buffer)
+    {
+        render::destroy_buffer(context.allocator, *scratch);
+        restore_pools();
+        return relocations_buffer.message;
+    }
+
+    const auto submitted = submit_once(
+        renderer,
+        [&](VkCommandBuffer cmd)
+        {
+            // the live ranges go through the scratch buffer, so a range may move over its own previous location
+            for (u32 p = 0; p < COUNT_OF(pools); ++p)
+            {
+                if (!moves[p].to_scratch.empty())
+                {
+                    vkCmdCopyBuffer(cmd,
+                                    pools[p]->buffer.buffer,
+                                    scratch->buffer,
+                                    static_cast<u32>(moves[p].to_scratch.size()),
+                                    moves[p].to_scratch.data());
+                }
+            }
+
+            render::cmd_stage_barrier(cmd,
+                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+            for (u32 p = 0; p < COUNT_OF(pools); ++p)
+            {
+                if (!moves[p].from_scratch.empty())
+                {
+                    vkCmdCopyBuffer(cmd,
+                                    scratch->buffer,
+                                    pools[p]->buffer.buffer,
+                                    static_cast<u32>(moves[p].from_scratch.size()),
+                                    moves[p].from_scratch.data());
+                }
+            }
+
+            render::cmd_stage_barrier(cmd,
+                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                      VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+            if (meshes_count > 0)
+            {
+                cmd_relocate_meshes(cmd, relocate_meshes, meshes_data, *relocations_buffer, meshes_count);
+            }
+
+            // meshlet payload offsets are absolute, one row of invocations per geometry
+            if (max_meshlets_count > 0 && payload_moved)
+            {
+                const vk_descriptor_info bindings[] = {pool.meshlets.buffer.buffer, relocations_buffer->buffer};
+                relocate_meshlets.bind(cmd);
+                relocate_meshlets.push_descriptor_set(cmd, bindings);
+                relocate_meshlets.dispatch(cmd, max_meshlets_count, static_cast<u32>(relocations.size()), 1);
+            }
+        });
+
+    render::destroy_buffer(context.allocator, *scratch);
+    render::destroy_buffer(context.allocator, *relocations_buffer);
+
+    if (!submitted)
+    {
+        return submitted.message;
+    }
+
+    return relocations;
+}
+
+result<std::vector<render::vk_geometry_relocation>> render::set_geometry_residency(
+    const vk_renderer& renderer, vk_scene_geometry_pool& pool, geometry_residency residency,
+    const vk_pipeline& relocate_meshes, const vk_buffer& meshes_data, u32 meshes_count)
+{
+    ZoneScoped;
+
+    std::vector<vk_geometry_relocation> relocations(pool.geometries.size());
+    if (residency == pool.residency)
+    {
+        return relocations;
+    }
+
+    const bool to_meshlets = residency == geometry_residency::meshlets;
+    assert2(!to_meshlets || pool.meshlets.size > 0);
+
+    // frames in flight may still read the released ranges
+    vkDeviceWaitIdle(renderer.get_context().device);
+
+    // lod references of the representation that is not resident stay relative to the geometry, so uploading moves
+    // them from an empty range at zero and releasing moves them back
+    constexpr vk_shared_range kRelative {};
+
+    // meshlets and payload when switching to meshlets, indices and u16 indices otherwise
+    vk_shared_buffer& first_pool  = to_meshlets ? pool.meshlets : pool.index;
+    vk_shared_buffer& second_pool = to_meshlets ? pool.meshlets_payload : pool.index16;
+
+    struct switched_ranges
+    {
+        vk_shared_range first;
+        vk_shared_range second;
+    };
+
+    // every geometry gets its new ranges before any of them switches, so that a failure leaves the pool as it was
+    std::vector<switched_ranges> ranges(pool.geometries.size());
+    auto release_ranges = [&]
+    {
+        for (const auto& [first, second] : ranges)
+        {
+            first_pool.free(first);
+            second_pool.free(second);
+        }
+    };
+
+    for (u32 g = 0; g < pool.geometries.size(); ++g)
+    {
+        const auto& host = pool.host_geometries[g];
+        if (!pool.geometries[g].resident)
+        {
+            continue;
+        }
+
+        const u64 first_size       = to_meshlets ? host.meshlets.size() : host.indices.size() * sizeof(u32);
+        const u64 first_alignment  = to_meshlets ? sizeof(static_model::meshlet) : sizeof(u32);
+        const u64 second_size      = to_meshlets ? host.meshlets_payload.size() : host.indices16.size() * sizeof(u16);
+        const u64 second_alignment = to_meshlets ? sizeof(u32) : sizeof(u16);
+
+        auto first = first_pool.allocate_or_grow(pool.transfer, first_size, first_alignment);
+        if (!first)
+        {
+            release_ranges();
+            return first.message;
+        }
+
+        ranges[g].first = *first;
+
+        auto second = second_pool.allocate_or_grow(pool.transfer, second_size, second_alignment);
+        if (!second)
+        {
+            release_ranges();
+            return second.message;
+        }
+
+        ranges[g].second = *second;
+    }
+
+    for (u32 g = 0; g < pool.geometries.size(); ++g)
+    {
+        const auto& geometry = pool.geometries[g];
+        if (!geometry.resident)
+        {
+            continue;
+        }
+
+        auto& relocation = relocations[g];
+        if (to_meshlets)
+        {
+            relocation.index_delta   = range_delta(geometry.index, kRelative, sizeof(u32));
+            relocation.index16_delta = range_delta(geometry.index16, kRelative, sizeof(u16));
+            relocation.meshlet_delta = range_delta(kRelative, ranges[g].first, sizeof(static_model::meshlet));
+        }
+        else
+        {
+            relocation.index_delta   = range_delta(kRelative, ranges[g].first, sizeof(u32));
+            relocation.index16_delta = range_delta(kRelative, ranges[g].second, sizeof(u16));
+            relocation.meshlet_delta = range_delta(geometry.meshlets, kRelative, sizeof(static_model::meshlet));
+        }
+    }
+
+    // the meshes table is patched right after the switch, so its relocations are uploaded before anything changes
+    result<vk_buffer> relocations_buffer = vk_buffer {};
+    if (meshes_count > 0)
+    {
+        relocations_buffer = upload_relocations(renderer, pool, relocations);
+        if (!relocations_buffer)
+        {
+            release_ranges();
+            return relocations_buffer.message;
+        }
+    }
+
+    for (u32 g = 0; g < pool.geometries.size(); ++g)
+    {
+        auto& geometry   = pool.geometries[g];
+        const auto& host = pool.host_geometries[g];
+        if (!geometry.resident)
+        {
+            continue;
+        }
+
+        const auto& [first, second] = ranges[g];
+        if (to_meshlets)
+        {
+            std::vector<static_model::meshlet> patched(host.meshlets.size() / sizeof(static_model::meshlet));
+            std::memcpy(patched.data(), host.meshlets.data(), host.meshlets.size());
+            for (auto& m : patched)
+            {
+                m.payload_offset += second.offset;
+            }
+
+            if (!patched.empty())
+            {
+                render::upload_data(pool.transfer,
+                                    pool.meshlets.buffer,
+                                    reinterpret_cast<const u8*>(patched.data()),
+                                    VkBufferCopy {.dstOffset = first.offset, .size = first.size});
+                render::upload_data(pool.transfer,
+                                    pool.meshlets_payload.buffer,
+                                    host.meshlets_payload.data(),
+                                    VkBufferCopy {.dstOffset = second.offset, .size = second.size});
+            }
+
+            pool.index.free(geometry.index);
+            pool.index16.free(geometry.index16);
+            geometry.index            = {};
+            geometry.index16          = {};
+            geometry.meshlets         = first;
+            geometry.meshlets_payload = second;
+        }
+        else
+        {
+            if (!host.indices.empty())
+            {
+                render::upload_data(pool.transfer,
+                                    pool.index.buffer,
+                                    reinterpret_cast<const u8*>(host.indices.data()),
+                                    VkBufferCopy {.dstOffset = first.offset, .size = first.size});
+            }
+
+            if (!host.indices16.empty())
+            {
+                render::upload_data(pool.transfer,
+                                    pool.index16.buffer,
+                                    reinterpret_cast<const u8*>(host.indices16.data()),
+                                    VkBufferCopy {.dstOffset = second.offset, .size = second.size});
+            }
+
+            pool.meshlets.free(geometry.meshlets);
+            pool.meshlets_payload.free(geometry.meshlets_payload);
+            geometry.index            = first;
+            geometry.index16          = second;
+            geometry.meshlets         = {};
+            geometry.meshlets_payload = {};
+        }
+    }
+
+    pool.residency = residency;
+
+    if (meshes_count == 0)
+    {
+        return relocations;
+    }
+
+    const auto submitted = submit_once(renderer,
+                                       [&](VkCommandBuffer cmd)
+                                       {
+                                           cmd_relocate_meshes(
+                                               cmd, relocate_meshes, meshes_data, *relocations_buffer, meshes_count);
+                                       });
+
+    render::destroy_buffer(renderer.get_context().allocator, *relocations_buffer);
+
+    if (!submitted)
+    {
+        return submitted.message;
+    }
+
+    return relocations;
+}
@@ -4,34 +4,147 @@
 
 #include <render/platform/vk/vk_buffer.hpp>
 #include <render/platform/vk/vk_buffer_transfer.hpp>
+#include <render/platform/vk/vk_pipeline.hpp>
 #include <render/platform/vk/vk_renderer.hpp>
+#include <result.hpp>
+
+#include <vector>
 
 namespace render
 {
+    // allocation handle within a vk_shared_buffer, in bytes
+    struct vk_shared_range
+    {
+        u64 offset {0};
+        u64 size {0};
+    };
+
+    // First-fit suballocator over a single device buffer, freed ranges are coalesced with their neighbours
     struct vk_shared_buffer
     {
         u64 size {0};
-        u64 offset {0};
+        u64 used {0};
         vk_buffer buffer;
+        std::vector<vk_shared_range> free_ranges;  // sorted by offset, never adjacent to each other
 
         vk_shared_buffer() = default;
 
         explicit vk_shared_buffer(const render::vk_renderer& renderer, const u64 size, VkBufferUsageFlags usage)
             : size(size)
-            , offset(0)
+            , used(0)
+            , free_ranges {vk_shared_range {.offset = 0, .size = size}}
         {
-            buffer = *render::create_buffer(
-                size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, renderer.get_context().allocator, 0);
+            // transfer source for the defragmentation copies
+            buffer = *render::create_buffer(size,
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | usage,
+                                            renderer.get_context().allocator,
+                                            0);
         }
+
+        // empty range for zero bytes, the offset is a multiple of alignment (which does not have to be a power of two)
+        result<vk_shared_range> allocate(u64 bytes, u64 alignment);
+
+        void free(const vk_shared_range& range);
+
+        [[nodiscard]] u64 largest_free_range() const;
+
+        // reallocates the buffer with at least min_free_bytes more at its end, keeping the allocated ranges in place
+        bool grow(const vk_buffer_transfer& transfer, u64 min_free_bytes);
+
+        // grows the buffer by the request and its worst case alignment padding if it does not fit
+        result<vk_shared_range> allocate_or_grow(const vk_buffer_transfer& transfer, u64 bytes, u64 alignment);
+    };
+
+    // representation of the geometry kept in the pools next to the vertices, only the active draw path needs one
+    enum class geometry_residency
+    {
+        indexed,   // index and index16 pools
+        meshlets,  // meshlets and meshlets_payload pools
+    };
+
+    // Host copy of both representations of a geometry, with lod references and payload offsets relative to the
+    // geometry. The representation that is not resident gets uploaded from here when the pool switches to it.
+    struct vk_geometry_host_data
+    {
+        std::vector<u32> indices;
+        std::vector<u16> indices16;
+        std::vector<u8> meshlets;  // static_model::meshlet
+        std::vector<u8> meshlets_payload;
+    };
+
+    // ranges of a single geometry (one static_model) in every pool, indexed by static_model::geometry_id
+    struct vk_geometry_allocation
+    {
+        vk_shared_range index;
+        vk_shared_range index16;
+        vk_shared_range position;
+        vk_shared_range attribute;
+        vk_shared_range meshlets;
+        vk_shared_range meshlets_payload;
+        bool resident {false};
+    };
+
+    // How far the geometry moved in each pool, in elements of that pool (bytes for the meshlets payload).
+    // Mirrors GeometryRelocation in shaders/types.glsl, applied on the cpu by static_model::relocate.
+    struct vk_geometry_relocation
+    {
+        i32 vertex_delta {0};
+        i32 index_delta {0};
+        i32 index16_delta {0};
+        i32 meshlet_delta {0};
+        i32 payload_delta {0};
+        u32 base_meshlet {0};  // first meshlet of the geometry after the move
+        u32 meshlets_count {0};
+        u32 padding {0};
     };
 
     struct vk_scene_geometry_pool
     {
         vk_shared_buffer index;
-        vk_shared_buffer vertex;
+        vk_shared_buffer index16;    // u16 indices of the lods that reference less than 64k vertices
+        vk_shared_buffer position;   // static_model::packed_position
+        vk_shared_buffer attribute;  // static_model::packed_attributes
         vk_shared_buffer meshlets;
         vk_shared_buffer meshlets_payload;
 
         vk_buffer_transfer transfer;
+        u32 geometry_count {0};  // ids handed out so far, the tables indexed by geometry id are sized by it
+        u32 meshlet_config_index {0};  // render::kMeshletConfigs entry the meshlets are built with
+        geometry_residency residency {geometry_residency::indexed};
+        bool compact_lod_vertices {false};  // simplified lods get a fetch-ordered copy of the vertices they reference
+
+        std::vector<vk_geometry_allocation> geometries;
+        std::vector<vk_geometry_host_data> host_geometries;
+        std::vector<u32> free_geometry_ids;  // of the freed geometries, reused before geometry_count grows
     };
+
+    // registers the allocated geometry under a freed id if there is one, so that the id range stays bounded by the
+    // geometries resident at once
+    u32 add_geometry(vk_scene_geometry_pool& pool, const vk_geometry_allocation& allocation,
+                     vk_geometry_host_data&& host_data);
+
+    // releases the ranges, the host copy and the id of the geometry, instances referencing it must be gone from the
+    // meshes table by then
+    void free_geometry(vk_scene_geometry_pool& pool, u32 geometry_id);
+
+    // Moves every resident geometry towards the start of its pools and patches the moved references of the meshes
+    // table and the meshlets on the gpu. Stalls the device. Returns one relocation per geometry id, which the
+    // cpu-side copies of the models have to be patched with as well.
+    result<std::vector<vk_geometry_relocation>> defragment_geometry_pool(const vk_renderer& renderer,
+                                                                         vk_scene_geometry_pool& pool,
+                                                                         const vk_pipeline& relocate_meshes,
+                                                                         const vk_pipeline& relocate_meshlets,
+                                                                         const vk_buffer& meshes_data,
+                                                                         u32 meshes_count);
+
+    // Uploads the representation of every resident geometry the pool switches to from the host copies, releases the
+    // other one and patches the lod references of the meshes table on the gpu. Stalls the device. Returns one
+    // relocation per geometry id, which the cpu-side copies of the models have to be patched with as well. Either
+    // every geometry switches or, when the new ranges cannot be allocated, none does.
+    result<std::vector<vk_geometry_relocation>> set_geometry_residency(const vk_renderer& renderer,
+                                                                       vk_scene_geometry_pool& pool,
+                                                                       geometry_residency residency,
+                                                                       const vk_pipeline& relocate_meshes,
+                                                                       const vk_buffer& meshes_data,
+                                                                       u32 meshes_count);
 }
@@ -71,8 +71,8 @@ namespace
                                     const vk_shader* shaders, u32 shaders_count,
                                     VkDescriptorUpdateTemplate* update_template)
     {
-        u32 entries_count = 0;
-        VkDescriptorUpdateTemplateEntry entries[COUNT_OF(vk_shader::shader_meta::bindings)] {};
+        u32 bindings_count = 0;
+        VkDescriptorUpdateTemplateEntry bindings[COUNT_OF(vk_shader::shader_meta::bindings)] {};
 
         for (u32 i = 0; i < shaders_count; ++i)
         {
@@ -81,8 +81,8 @@ namespace
             {
                 if (shader_meta.bindings[j] != VK_DESCRIPTOR_TYPE_MAX_ENUM)
                 {
-                    entries_count = std::max(entries_count, j + 1);
-                    entries[j]    = {
+                    bindings_count = std::max(bindings_count, j + 1);
+                    bindings[j]    = {
                            .dstBinding      = j,
                            .descriptorCount = 1,
                            .descriptorType  = shader_meta.bindings[j],
@@ -93,6 +93,17 @@ namespace
             }
         }
 
+        // shader variants may skip binding numbers, the updates array keeps being indexed by the binding
+        u32 entries_count = 0;
+        VkDescriptorUpdateTemplateEntry entries[COUNT_OF(vk_shader::shader_meta::bindings)] {};
+        for (u32 j = 0; j < bindings_count; ++j)
+        {
+            if (bindings[j].descriptorCount > 0)
+            {
+                entries[entries_count++] = bindings[j];
+            }
+        }
+
         if (entries_count == 0)
         {
             *update_template = VK_NULL_HANDLE;
@@ -131,8 +142,8 @@ namespace
     VkResult create_pipeline_layout(VkDevice device, const vk_shader* shaders, u32 shaders_count,
                                     const VkPushConstantRange& push_constant_range, VkPipelineLayout* layout)
     {
-        u32 entries_count = 0;
-        VkDescriptorSetLayoutBinding entries[COUNT_OF(vk_shader::shader_meta::bindings)] {};
+        u32 bindings_count = 0;
+        VkDescriptorSetLayoutBinding bindings[COUNT_OF(vk_shader::shader_meta::bindings)] {};
 
         for (u32 i = 0; i < shaders_count; ++i)
         {
@@ -141,16 +152,27 @@ namespace
             {
                 if (shader_meta.bindings[j] != VK_DESCRIPTOR_TYPE_MAX_ENUM)
                 {
-                    entries_count = std::max(entries_count, j + 1);
+                    bindings_count = std::max(bindings_count, j + 1);
 
-                    entries[j].binding         = j;
-                    entries[j].descriptorType  = shader_meta.bindings[j];
-                    entries[j].descriptorCount = 1;
-                    entries[j].stageFlags |= shader_meta.stage;
+                    bindings[j].binding         = j;
+                    bindings[j].descriptorType  = shader_meta.bindings[j];
+                    bindings[j].descriptorCount = 1;
+                    bindings[j].stageFlags |= shader_meta.stage;
                 }
             }
         }
 
+        // skipped binding numbers must not end up in the layout as zero initialized duplicates of binding 0
+        u32 entries_count = 0;
+        VkDescriptorSetLayoutBinding entries[COUNT_OF(vk_shader::shader_meta::bindings)] {};
+        for (u32 j = 0; j < bindings_count; ++j)
+        {
+            if (bindings[j].descriptorCount > 0)
+            {
+                entries[entries_count++] = bindings[j];
+            }
+        }
+
         const VkDescriptorSetLayoutCreateInfo desc_set_layout_info {
             .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
             .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
@@ -502,13 +524,22 @@ result<vk_pipeline> vk_pipeline::create_compute(const vk_renderer& renderer, con
 }
 
 result<vk_pipeline> vk_pipeline::create_graphics(const vk_renderer& renderer, const vk_shader* shaders,
-                                                 u32 shaders_count, VkPrimitiveTopology topology)
+                                                 u32 shaders_count, VkPrimitiveTopology topology,
+                                                 VkCompareOp depth_compare_op)
 {
     ZoneScoped;
+    // a pipeline without a fragment stage is depth-only and renders without color attachments
+    u32 color_attachments_count = 0;
+
     std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos(shaders_count);
     for (u32 i = 0; i < shaders_count; ++i)
     {
         assert2(shaders[i].meta.stage != VK_SHADER_STAGE_COMPUTE_BIT);
+        if (shaders[i].meta.stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+        {
+            color_attachments_count = 1;
+        }
+
         shader_stage_create_infos[i] = {
             .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage  = shaders[i].meta.stage,
@@ -584,7 +615,7 @@ result<vk_pipeline> vk_pipeline::create_graphics(const vk_renderer& renderer, co
         .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
         .logicOpEnable   = VK_FALSE,
         .logicOp         = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
+        .attachmentCount = color_attachments_count,
         .pAttachments    = &color_blend_attachment_state,
         .blendConstants  = {0.0f, 0.0f, 0.0f, 0.0f},
     };
@@ -592,7 +623,7 @@ result<vk_pipeline> vk_pipeline::create_graphics(const vk_renderer& renderer, co
     const VkPipelineRenderingCreateInfo pipeline_rendering_create_info {
         .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
         .pNext                   = nullptr,
-        .colorAttachmentCount    = 1,
+        .colorAttachmentCount    = color_attachments_count,
         .pColorAttachmentFormats = &renderer.get_swapchain().surface_format.format,
         .depthAttachmentFormat   = renderer.get_swapchain().depth_format,
     };
@@ -602,7 +633,7 @@ result<vk_pipeline> vk_pipeline::create_graphics(const vk_renderer& renderer, co
         .pNext            = nullptr,
         .depthTestEnable  = VK_TRUE,
         .depthWriteEnable = VK_TRUE,
-        .depthCompareOp   = VK_COMPARE_OP_GREATER,
+        .depthCompareOp   = depth_compare_op,
         .minDepthBounds   = 0.0f,
         .maxDepthBounds   = 1.0f,
     };
@@ -692,3 +723,8 @@ void vk_pipeline::dispatch(VkCommandBuffer command_buffer, u32 global_x, u32 glo
                   align_wg(global_y, work_group_size[1]),
                   align_wg(global_z, work_group_size[2]));
 }
+
+void vk_pipeline::dispatch_indirect(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset) const
+{
+    vkCmdDispatchIndirect(command_buffer, buffer, offset);
+}
@@ -80,9 +80,11 @@ namespace render
 
         static result<vk_pipeline> create_compute(const vk_renderer& renderer, const vk_shader& shader);
 
+        // depth is reverse Z, GREATER_OR_EQUAL is only meant for pipelines redrawing a depth-only pass output
         static result<vk_pipeline> create_graphics(const vk_renderer& renderer, const vk_shader* shaders,
                                                    u32 shaders_count,
-                                                   VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+                                                   VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                                   VkCompareOp depth_compare_op = VK_COMPARE_OP_GREATER);
 
         void bind(VkCommandBuffer command_buffer) const;
 
@@ -92,6 +94,9 @@ namespace render
 
         void dispatch(VkCommandBuffer command_buffer, u32 global_x, u32 global_y, u32 global_z) const;
 
+        // group counts are read from a VkDispatchIndirectCommand, no work group size alignment is applied
+        void dispatch_indirect(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset) const;
+
         template<typename T>
         void push_constant(VkCommandBuffer command_buffer, T&& data) const
         {
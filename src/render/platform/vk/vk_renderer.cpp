@@ -68,6 +68,10 @@ void vk_renderer::resize_swapchain(ivec2 new_size)
     ZoneScoped;
     vkWaitForFences(m_context.device, 1, &m_in_flight_frames[m_frame_index].fence, VK_TRUE, UINT64_MAX);
 
+    auto& arena = m_in_flight_frames[m_frame_index].arena;
+    TracyPlot("frame arena bytes", static_cast<i64>(arena.used()));
+    arena.reset();
+
     const auto acquire_result = vkAcquireNextImageKHR(m_context.device,
                                                       m_swapchain.vk_swapchain,
                                                       UINT64_MAX,
@@ -195,6 +199,11 @@ u32 vk_renderer::get_frames_in_flight() const
     return m_in_flight_frames[m_frame_index].command_buffer.cmd_buffer;
 }
 
+[[nodiscard]] cpp::linear_arena& vk_renderer::get_frame_arena() const
+{
+    return m_in_flight_frames[m_frame_index].arena;
+}
+
 [[nodiscard]] render::swapchain_image vk_renderer::get_frame_swapchain_image() const
 {
     return m_swapchain.images[m_image_index];
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bytes.hpp>
+#include <cpp/memory/linear_arena.hpp>
 #include <render/platform/vk/vk_device.hpp>
 #include <render/platform/vk/vk_command_buffer.hpp>
 #include <tracy/TracyVulkan.hpp>
@@ -18,6 +19,9 @@ namespace render
 
             VkFence fence {VK_NULL_HANDLE};
             VkSemaphore acquire_semaphore {VK_NULL_HANDLE};
+
+            // temporaries of the frame recording, reset once the frame's fence signaled
+            mutable cpp::linear_arena arena;
         };
 
     public:
@@ -47,6 +51,9 @@ namespace render
 
         [[nodiscard]] VkCommandBuffer get_frame_command_buffer() const;
 
+        // valid until this frame index is acquired again, see cpp::arena_allocator
+        [[nodiscard]] cpp::linear_arena& get_frame_arena() const;
+
         [[nodiscard]] render::swapchain_image get_frame_swapchain_image() const;
 
         template<typename Func>
@@ -3,14 +3,18 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <cpp/alg_constexpr.hpp>
+#include <cpp/memory/linear_arena.hpp>
 #include <fs/fs.hpp>
 #include <meshoptimizer.h>
 #include <render/sm_cache.hpp>
 #include <render/sm_serializer.hpp>
 #include <render/static_model.hpp>
 
+#include <cstddef>
 #include <filesystem>
+#include <memory>
 #include <stack>
+#include <utility>
 
 namespace
 {
@@ -28,10 +32,31 @@ namespace
     {
         return std::filesystem::exists(get_cache_path(path).c_str());
     }
+
+    // meshoptimizer frees its temporaries in reverse order at the end of every call, so freeing one rewinds the arena
+    // to where it was before the allocation
+    void* MESHOPTIMIZER_ALLOC_CALLCONV meshopt_scratch_allocate(const size_t size)
+    {
+        using marker = cpp::linear_arena::marker;
+        static_assert(sizeof(marker) % alignof(std::max_align_t) == 0);
+
+        auto& arena       = cpp::thread_scratch_arena();
+        const marker from = arena.get_marker();
+
+        auto* header = static_cast<marker*>(arena.allocate(sizeof(marker) + size, alignof(std::max_align_t)));
+        *header      = from;
+        return header + 1;
+    }
+
+    void MESHOPTIMIZER_ALLOC_CALLCONV meshopt_scratch_deallocate(void* ptr)
+    {
+        cpp::thread_scratch_arena().rewind(static_cast<const cpp::linear_arena::marker*>(ptr)[-1]);
+    }
 }
 
-using sm_vertex    = static_model::vertex;
-using sm_mesh_data = render::mesh_data<sm_vertex>;
+using sm_vertex        = static_model::vertex;
+using sm_packed_vertex = static_model::packed_vertex;
+using sm_mesh_data     = render::mesh_data<sm_vertex>;
 
 template<typename T>
 render::mesh_data<T> load_mesh(const aiMesh* mesh) noexcept;
@@ -42,7 +67,10 @@ sm_mesh_data load_mesh<sm_vertex>(const aiMesh* mesh) noexcept
     ZoneScoped;
     assert2(mesh->HasNormals());
 
-    std::vector<sm_vertex> raw_vertices(mesh->mNumVertices);
+    cpp::scratch_scope scratch(cpp::thread_scratch_arena());
+
+    auto* raw_vertices = scratch.arena().allocate<sm_vertex>(mesh->mNumVertices);
+    std::uninitialized_value_construct_n(raw_vertices, mesh->mNumVertices);
     for (u32 i = 0; i < mesh->mNumVertices; i++)
     {
         if (mesh->mTextureCoords[0]) [[likely]]
@@ -78,13 +106,13 @@ sm_mesh_data load_mesh<sm_vertex>(const aiMesh* mesh) noexcept
     }
 
     u64 vertex_count = 0;
-    std::vector<u32> remap(indices.size());
+    auto* remap      = scratch.arena().allocate<u32>(indices.size());
 
     {
         ZoneScopedN("meshopt_generateVertexRemap");
 
         vertex_count = meshopt_generateVertexRemap(
-            remap.data(), indices.data(), indices.size(), raw_vertices.data(), raw_vertices.size(), sizeof(sm_vertex));
+            remap, indices.data(), indices.size(), raw_vertices, mesh->mNumVertices, sizeof(sm_vertex));
     }
 
     std::vector<sm_vertex> vertices(vertex_count);
@@ -92,9 +120,8 @@ sm_mesh_data load_mesh<sm_vertex>(const aiMesh* mesh) noexcept
     {
         ZoneScopedN("meshopt_remap[Vertex/Index]Buffer");
 
-        meshopt_remapVertexBuffer(
-            vertices.data(), raw_vertices.data(), raw_vertices.size(), sizeof(sm_vertex), remap.data());
-        meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+        meshopt_remapVertexBuffer(vertices.data(), raw_vertices, mesh->mNumVertices, sizeof(sm_vertex), remap);
+        meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap);
     }
 
     {
@@ -112,11 +139,18 @@ sm_mesh_data load_mesh<sm_vertex>(const aiMesh* mesh) noexcept
                                     sizeof(static_model::vertex));
     }
 
-    return {.vertices = vertices, .indices = indices};
+    // snap to the packed representation, so that lods and meshlet bounds are built from what the gpu reads
+    const vec4 position_bounds = static_model::compute_position_bounds(vertices);
+    for (auto& v : vertices)
+    {
+        v = static_model::unpack_vertex(static_model::pack_vertex(v, position_bounds), position_bounds);
+    }
+
+    return {.vertices = std::move(vertices), .indices = std::move(indices), .position_bounds = position_bounds};
 }
 
 template<typename T>
-bool load_from_cache(const fs::path& path, std::vector<T>& meshes)
+bool load_from_cache(const fs::path& path, std::vector<T>& meshes, cpp::job_system& jobs)
 {
     if (has_cache(path))
     {
@@ -129,34 +163,53 @@ bool load_from_cache(const fs::path& path, std::vector<T>& meshes)
             return false;
         }
 
+        // the entries are walked in order to find where each one starts, then the meshes are read in parallel
+        std::vector<u64> mesh_offsets(mesh_count);
         u64 data_pointer = 0;
-        meshes.resize(mesh_count);
         for (u32 i = 0; i < mesh_count; i++)
         {
-            auto& data = meshes[i];
-
-            u64 indices_count   = 0;
-            u64 vertices_count  = 0;
-            u64 vertices_stride = 0;
-
-            render::load_mesh_cache_stats(
-                &(*model_cache)[data_pointer], indices_count, vertices_count, vertices_stride);
-
-            assert2(vertices_stride == sizeof(sm_vertex));
-
-            data.indices.resize(indices_count);
-            data.vertices.resize(vertices_count);
-
-            render::load_mesh_cache_data(&(*model_cache)[data_pointer],
-                                         data.indices.data(),
-                                         data.vertices.data(),
-                                         indices_count,
-                                         vertices_count,
-                                         vertices_stride);
-
-            data_pointer += indices_count * sizeof(u32) + vertices_count * vertices_stride;
+            mesh_offsets[i] = data_pointer;
+            data_pointer += render::get_mesh_cache_size(&(*model_cache)[data_pointer]);
         }
 
+        meshes.resize(mesh_count);
+        jobs.parallel_for(mesh_count,
+                          1,
+                          [&](const u64 i)
+                          {
+                              ZoneScopedN("load mesh from cache");
+                              auto& data = meshes[i];
+
+                              u64 indices_count   = 0;
+                              u64 vertices_count  = 0;
+                              u64 vertices_stride = 0;
+
+                              render::load_mesh_cache_stats(
+                                  &(*model_cache)[mesh_offsets[i]], indices_count, vertices_count, vertices_stride);
+
+                              assert2(vertices_stride == sizeof(sm_packed_vertex));
+
+                              data.indices.resize(indices_count);
+                              data.vertices.resize(vertices_count);
+
+                              cpp::scratch_scope scratch(cpp::thread_scratch_arena());
+                              auto* packed_vertices = scratch.arena().allocate<sm_packed_vertex>(vertices_count);
+
+                              render::load_mesh_cache_data(&(*model_cache)[mesh_offsets[i]],
+                                                           data.indices.data(),
+                                                           packed_vertices,
+                                                           data.position_bounds,
+                                                           indices_count,
+                                                           vertices_count,
+                                                           vertices_stride);
+
+                              for (u64 v = 0; v < vertices_count; ++v)
+                              {
+                                  data.vertices[v] =
+                                      static_model::unpack_vertex(packed_vertices[v], data.position_bounds);
+                              }
+                          });
+
         return true;
     }
 
@@ -164,7 +217,7 @@ bool load_from_cache(const fs::path& path, std::vector<T>& meshes)
 }
 
 template<>
-result<std::vector<sm_mesh_data>> render::parse_model<sm_vertex>(const fs::path& path)
+result<std::vector<sm_mesh_data>> render::parse_model<sm_vertex>(const fs::path& path, cpp::job_system& jobs)
 {
     ZoneScoped;
 
@@ -177,7 +230,7 @@ result<std::vector<sm_mesh_data>> render::parse_model<sm_vertex>(const fs::path&
     const auto& data = contents.value;
 
     const aiScene* scene = nullptr;
-    std::vector<sm_mesh_data> meshes;
+    std::vector<const aiMesh*> scene_meshes;
 
     {
         ZoneScopedN("Assimp::ReadFileFromMemory");
@@ -213,8 +266,7 @@ result<std::vector<sm_mesh_data>> render::parse_model<sm_vertex>(const fs::path&
             {
                 // the node object only contains indices to index the actual objects in the scene.
                 // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-                const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-                meshes.push_back(load_mesh<sm_vertex>(mesh));
+                scene_meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
             }
 
             for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -224,11 +276,15 @@ result<std::vector<sm_mesh_data>> render::parse_model<sm_vertex>(const fs::path&
         }
     }
 
+    // the scene stays alive in the importer of this thread until its next read
+    std::vector<sm_mesh_data> meshes(scene_meshes.size());
+    jobs.parallel_for(scene_meshes.size(), 1, [&](const u64 i) { meshes[i] = load_mesh<sm_vertex>(scene_meshes[i]); });
+
     return meshes;
 }
 
 template<>
-bool render::load_model<sm_vertex>(const fs::path& path, std::vector<sm_mesh_data>& meshes)
+bool render::load_model<sm_vertex>(const fs::path& path, std::vector<sm_mesh_data>& meshes, cpp::job_system& jobs)
 {
     ZoneScoped;
 
@@ -237,33 +293,45 @@ bool render::load_model<sm_vertex>(const fs::path& path, std::vector<sm_mesh_dat
         return false;
     }
 
-    if (load_from_cache(path, meshes))
+    if (load_from_cache(path, meshes, jobs))
     {
         return true;
     }
 
-    auto parsed = parse_model<sm_vertex>(path);
+    auto parsed = parse_model<sm_vertex>(path, jobs);
     if (!parsed)
     {
         return false;
     }
 
-    meshes = parsed.value;
+    meshes = std::move(parsed.value);
 
     {
         ZoneScopedN("create cache entry");
 
-        std::vector<bytes> cache;
-        cache.reserve(meshes.size());
-
-        for (auto& mesh_data : meshes)
-        {
-            cache.push_back(*render::serialize_mesh_cache(mesh_data.indices.data(),
-                                                          mesh_data.indices.size(),
-                                                          mesh_data.vertices.data(),
-                                                          mesh_data.vertices.size(),
-                                                          sizeof(sm_vertex)));
-        }
+        std::vector<bytes> cache(meshes.size(), bytes(0));
+        jobs.parallel_for(meshes.size(),
+                          1,
+                          [&](const u64 i)
+                          {
+                              const auto& mesh_data = meshes[i];
+
+                              cpp::scratch_scope scratch(cpp::thread_scratch_arena());
+                              auto* packed_vertices =
+                                  scratch.arena().allocate<sm_packed_vertex>(mesh_data.vertices.size());
+                              for (u64 v = 0; v < mesh_data.vertices.size(); ++v)
+                              {
+                                  packed_vertices[v] =
+                                      static_model::pack_vertex(mesh_data.vertices[v], mesh_data.position_bounds);
+                              }
+
+                              cache[i] = *render::serialize_mesh_cache(mesh_data.indices.data(),
+                                                                       mesh_data.indices.size(),
+                                                                       packed_vertices,
+                                                                       mesh_data.vertices.size(),
+                                                                       sizeof(sm_packed_vertex),
+                                                                       mesh_data.position_bounds);
+                          });
 
         auto model_cache = render::serialize_model_cache(cache.data(), cache.size());
         if (!model_cache)
@@ -277,3 +345,8 @@ bool render::load_model<sm_vertex>(const fs::path& path, std::vector<sm_mesh_dat
 
     return true;
 }
+
+void render::set_meshopt_scratch_allocator()
+{
+    meshopt_setAllocator(meshopt_scratch_allocate, meshopt_scratch_deallocate);
+}
@@ -2,6 +2,7 @@
 
 #include <types.hpp>
 
+#include <cpp/jobs/job_system.hpp>
 #include <fs/path.hpp>
 #include <result.hpp>
 
@@ -14,11 +15,16 @@ namespace render
     {
         std::vector<V> vertices;
         std::vector<u32> indices;
+        vec4 position_bounds {0.0F};  // quantization bounds the vertices were snapped to
     };
 
+    // the meshes are processed in parallel on the jobs
     template<typename V>
-    result<std::vector<mesh_data<V>>> parse_model(const fs::path& path);
+    result<std::vector<mesh_data<V>>> parse_model(const fs::path& path, cpp::job_system& jobs);
 
     template<typename V>
-    bool load_model(const fs::path& path, std::vector<mesh_data<V>>& meshes);
+    bool load_model(const fs::path& path, std::vector<mesh_data<V>>& meshes, cpp::job_system& jobs);
+
+    // meshoptimizer takes its temporaries from the scratch arena of the calling thread, see cpp::thread_scratch_arena
+    void set_meshopt_scratch_allocator();
 }
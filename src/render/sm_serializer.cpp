@@ -8,13 +8,14 @@
 
 namespace
 {
-    constexpr u64 kSMMagic = "wazzup"_hs;
+    constexpr u64 kSMMagic = "wazzup_packed"_hs;
 
     struct mesh_header
     {
         u64 indices_count {0};
         u64 vertices_count {0};
         u64 vertices_stride {0};
+        f32 position_bounds[4] {};
     };
 
     struct model_header
@@ -25,7 +26,7 @@ namespace
 }
 
 result<bytes> render::serialize_mesh_cache(const u32* indices, u64 indices_count, const void* vertices,
-                                           u64 vertices_count, u64 vertices_stride)
+                                           u64 vertices_count, u64 vertices_stride, const vec4& position_bounds)
 {
     ZoneScoped;
     if (!indices || !vertices || indices_count == 0 || vertices_count == 0)
@@ -49,6 +50,7 @@ result<bytes> render::serialize_mesh_cache(const u32* indices, u64 indices_count
         .indices_count   = indices_count,
         .vertices_count  = vertices_count,
         .vertices_stride = vertices_stride,
+        .position_bounds = {position_bounds.x, position_bounds.y, position_bounds.z, position_bounds.w},
     };
 
     write(&header, sizeof(header));
@@ -58,8 +60,8 @@ result<bytes> render::serialize_mesh_cache(const u32* indices, u64 indices_count
     return result;
 }
 
-void render::load_mesh_cache_data(const void* data, u32* indices, void* vertices, u64 indices_count, u64 vertices_count,
-                                  u64 vertices_stride)
+u64 render::load_mesh_cache_data(const void* data, u32* indices, void* vertices, vec4& position_bounds,
+                                 u64 indices_count, u64 vertices_count, u64 vertices_stride)
 {
     ZoneScoped;
 
@@ -81,8 +83,15 @@ void render::load_mesh_cache_data(const void* data, u32* indices, void* vertices
         data_pointer += bytes;
     };
 
+    mesh_header header;
+    cpp::cx_memcpy(&header, data, sizeof(header));
+    position_bounds = vec4(
+        header.position_bounds[0], header.position_bounds[1], header.position_bounds[2], header.position_bounds[3]);
+
     read(indices, indices_count * sizeof(u32));
     read(vertices, vertices_count * vertices_stride);
+
+    return data_pointer;
 }
 
 void render::load_mesh_cache_stats(const void* data, u64& indices_count, u64& vertices_count, u64& vertices_stride)
@@ -97,6 +106,14 @@ void render::load_mesh_cache_stats(const void* data, u64& indices_count, u64& ve
     vertices_stride = header.vertices_stride;
 }
 
+u64 render::get_mesh_cache_size(const void* data)
+{
+    mesh_header header;
+    cpp::cx_memcpy(&header, data, sizeof(header));
+
+    return sizeof(mesh_header) + header.indices_count * sizeof(u32) + header.vertices_count * header.vertices_stride;
+}
+
 result<bytes> render::serialize_model_cache(const bytes* meshes, u32 mesh_count)
 {
     ZoneScoped;
@@ -9,11 +9,16 @@
 namespace render
 {
     result<bytes> serialize_mesh_cache(const u32* indices, u64 indices_count, const void* vertices, u64 vertices_count,
-                                       u64 vertices_stride);
+                                       u64 vertices_stride, const vec4& position_bounds);
 
     void load_mesh_cache_stats(const void* data, u64& indices_count, u64& vertices_count, u64& vertices_stride);
 
-    void load_mesh_cache_data(const void* data, u32* indices, void* vertices, u64 indices_count, u64 vertices_count, u64 vertices_stride);
+    // size of the mesh entry, to advance to the next one without reading it
+    u64 get_mesh_cache_size(const void* data);
+
+    // returns the size of the mesh entry, to advance to the next one
+    u64 load_mesh_cache_data(const void* data, u32* indices, void* vertices, vec4& position_bounds, u64 indices_count,
+                             u64 vertices_count, u64 vertices_stride);
 
     result<bytes> serialize_model_cache(const bytes* meshes, u32 mesh_count);
 
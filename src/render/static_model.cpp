@@ -1,65 +1,247 @@
 #include <assert2.hpp>
+#include <cpp/memory/linear_arena.hpp>
 #include <meshoptimizer.h>
+#include <render/meshlet_config.hpp>
 #include <render/sm_cache.hpp>
 #include <render/static_model.hpp>
 #include <tracy/Tracy.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <span>
 #include <stack>
+#include <utility>
 
 using namespace render;
 
 namespace
 {
+    // geometry of one mesh built off the pools, allocated and uploaded once every mesh of the model is built
+    struct built_geometry
+    {
+        std::vector<static_model::packed_position> positions;
+        std::vector<static_model::packed_attributes> attributes;
+        std::vector<u32> indices;
+        std::vector<u16> indices16;
+        std::vector<static_model::meshlet> meshlets;
+        std::vector<u8> meshlets_payload;
+    };
+
     // TODO: batch data uploads together
     template<typename T>
-    void upload_data(const vk_buffer_transfer& transfer, vk_shared_buffer& dst_buffer, const T* data, const u64 count)
+    void upload_data(const vk_buffer_transfer& transfer, const vk_shared_buffer& dst_buffer,
+                     const vk_shared_range& range, const std::vector<T>& data)
     {
         ZoneScoped;
+        assert2(range.size == data.size() * sizeof(T));
+
+        if (data.empty())
+        {
+            return;
+        }
 
         render::upload_data(transfer,
                             dst_buffer.buffer,
-                            reinterpret_cast<const u8*>(data),
-                            VkBufferCopy {.srcOffset = 0, .dstOffset = dst_buffer.offset, .size = count * sizeof(T)});
-        dst_buffer.offset += count * sizeof(T);
+                            reinterpret_cast<const u8*>(data.data()),
+                            VkBufferCopy {.srcOffset = 0, .dstOffset = range.offset, .size = range.size});
+    }
+
+    // either every range of the geometry is allocated or none of them
+    result<vk_geometry_allocation> allocate_geometry(vk_scene_geometry_pool& pool, u64 vertices_count,
+                                                     u64 indices_count, u64 indices16_count, u64 meshlets_count,
+                                                     u64 payload_size)
+    {
+        ZoneScoped;
+
+        struct range_request
+        {
+            vk_shared_buffer& buffer;
+            vk_shared_range& range;
+            u64 size;
+            u64 alignment;
+        };
+
+        // the position and attribute pools are sized in proportion and see the same requests, so their ranges
+        // start at the same vertex. A pool that runs out grows in proportion as well
+        vk_geometry_allocation allocation {.resident = true};
+        const range_request requests[] = {
+            {pool.position,
+             allocation.position,
+             vertices_count * sizeof(static_model::packed_position),
+             sizeof(static_model::packed_position)},
+            {pool.attribute,
+             allocation.attribute,
+             vertices_count * sizeof(static_model::packed_attributes),
+             sizeof(static_model::packed_attributes)},
+            {pool.index, allocation.index, indices_count * sizeof(u32), sizeof(u32)},
+            {pool.index16, allocation.index16, indices16_count * sizeof(u16), sizeof(u16)},
+            {pool.meshlets,
+             allocation.meshlets,
+             meshlets_count * sizeof(static_model::meshlet),
+             sizeof(static_model::meshlet)},
+            {pool.meshlets_payload, allocation.meshlets_payload, payload_size, sizeof(u32)},
+        };
+
+        for (u32 r = 0; r < COUNT_OF(requests); ++r)
+        {
+            auto range = requests[r].buffer.allocate_or_grow(pool.transfer, requests[r].size, requests[r].alignment);
+            if (!range)
+            {
+                for (u32 k = 0; k < r; ++k)
+                {
+                    requests[k].buffer.free(requests[k].range);
+                }
+
+                return range.message;
+            }
+
+            requests[r].range = *range;
+        }
+
+        return allocation;
     }
 
+    // Ritter's sphere: starts from the most separated pair of axis extreme points and grows over the vertices left
+    // outside, usually within a few percent of the minimal sphere where the centroid one can be far off
     vec4 compute_bounding_sphere(const static_model::mesh_data& mesh)
     {
         ZoneScoped;
-        vec3 center(0.0F);
-        for (const auto& v : mesh.vertices)
+
+        const auto& vertices = mesh.vertices;
+        if (vertices.empty())
         {
-            center += v.position;
+            return vec4(0.0F);
         }
 
-        f32 radius = 0.0F;
-        center /= mesh.vertices.size();
+        u64 min_vertex[3] = {0, 0, 0};
+        u64 max_vertex[3] = {0, 0, 0};
+        for (u64 v = 0; v < vertices.size(); ++v)
+        {
+            for (u32 axis = 0; axis < 3; ++axis)
+            {
+                min_vertex[axis] =
+                    vertices[v].position[axis] < vertices[min_vertex[axis]].position[axis] ? v : min_vertex[axis];
+                max_vertex[axis] =
+                    vertices[v].position[axis] > vertices[max_vertex[axis]].position[axis] ? v : max_vertex[axis];
+            }
+        }
 
-        for (const auto& v : mesh.vertices)
+        u32 widest_axis = 0;
+        f32 widest_span = 0.0F;
+        for (u32 axis = 0; axis < 3; ++axis)
+        {
+            const f32 span =
+                glm::distance(vertices[min_vertex[axis]].position, vertices[max_vertex[axis]].position);
+            if (span > widest_span)
+            {
+                widest_axis = axis;
+                widest_span = span;
+            }
+        }
+
+        vec3 center =
+            (vertices[min_vertex[widest_axis]].position + vertices[max_vertex[widest_axis]].position) * 0.5F;
+        f32 radius = widest_span * 0.5F;
+
+        // the grown sphere contains the previous one, so a single pass covers every vertex
+        for (const auto& v : vertices)
         {
-            radius = glm::max(radius, glm::distance(center, v.position));
+            const f32 distance = glm::distance(center, v.position);
+            if (distance > radius)
+            {
+                const f32 grown_radius = (radius + distance) * 0.5F;
+                center += (v.position - center) * ((grown_radius - radius) / distance);
+                radius = grown_radius;
+            }
         }
 
         return {center, radius};
     }
 
-    void build_meshlets(const std::vector<static_model::vertex>& vertices, const std::vector<u32>& indices,
-                        std::vector<static_model::meshlet>& meshlets, std::vector<u8>& meshlets_payload,
-                        u32 base_payload_offset) noexcept
+    // object space box, half extents
+    std::pair<vec3, vec3> compute_bounding_box(const static_model::mesh_data& mesh)
     {
         ZoneScoped;
-        const u64 meshlets_upper_bound = meshopt_buildMeshletsBound(
-            indices.size(), static_model::kMaxVerticesPerMeshlet, static_model::kMaxTrianglesPerMeshlet);
 
-        const u64 vertices_offset = indices.size();
-        std::vector<u8> meshlets_data(indices.size() * 5);
+        if (mesh.vertices.empty())
+        {
+            return {vec3(0.0F), vec3(0.0F)};
+        }
 
-        u8* meshlet_indices_ptr   = meshlets_data.data();
-        u32* meshlet_vertices_ptr = reinterpret_cast<u32*>(meshlets_data.data() + vertices_offset);
+        vec3 min(std::numeric_limits<f32>::max());
+        vec3 max(std::numeric_limits<f32>::lowest());
+        for (const auto& v : mesh.vertices)
+        {
+            min = glm::min(min, v.position);
+            max = glm::max(max, v.position);
+        }
 
-        std::vector<meshopt_Meshlet> meshopt_meshlets(meshlets_upper_bound);
+        return {(min + max) * 0.5F, (max - min) * 0.5F};
+    }
+
+    i8 encode_snorm8(f32 v)
+    {
+        return static_cast<i8>(glm::round(glm::clamp(v, -1.0F, 1.0F) * 127.0F));
+    }
+
+    f32 decode_snorm8(i8 v)
+    {
+        return glm::max(static_cast<f32>(v) / 127.0F, -1.0F);
+    }
+
+    // https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+    vec2 encode_octahedral(vec3 n)
+    {
+        n /= glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+        if (n.z < 0.0F)
+        {
+            const vec2 sign_not_zero(n.x >= 0.0F ? 1.0F : -1.0F, n.y >= 0.0F ? 1.0F : -1.0F);
+            return (1.0F - glm::abs(vec2(n.y, n.x))) * sign_not_zero;
+        }
+
+        return {n.x, n.y};
+    }
+
+    vec3 decode_octahedral(const vec2 e)
+    {
+        vec3 n(e.x, e.y, 1.0F - glm::abs(e.x) - glm::abs(e.y));
+        const f32 t = glm::max(-n.z, 0.0F);
+        n.x += n.x >= 0.0F ? -t : t;
+        n.y += n.y >= 0.0F ? -t : t;
+        return glm::normalize(n);
+    }
+
+    u16 encode_unorm16(f32 v)
+    {
+        return static_cast<u16>(glm::round(glm::clamp(v, 0.0F, 1.0F) * 65535.0F));
+    }
+
+    // returns the amount of real meshlets, the rest of the vector is empty padding up to the task group size
+    template<meshlet_config Config>
+    u64 build_meshlets(std::span<const static_model::vertex> vertices, std::span<const u32> indices,
+                        const vec4& position_bounds, std::vector<static_model::meshlet>& meshlets,
+                        std::vector<u8>& meshlets_payload, u32 base_payload_offset) noexcept
+    {
+        static_assert(Config.max_vertices <= std::numeric_limits<u8>::max(), "meshlet counts and indices are u8");
+        static_assert(Config.max_triangles <= std::numeric_limits<u8>::max(), "meshlet counts and indices are u8");
+
+        ZoneScoped;
+        constexpr u64 kMaxIndicesPerMeshlet = Config.max_triangles * 3;
+
+        const u64 meshlets_upper_bound =
+            meshopt_buildMeshletsBound(indices.size(), Config.max_vertices, Config.max_triangles);
+
+        // the meshlets only live until they are packed into the payload, the next lod reuses their memory
+        cpp::scratch_scope scratch(cpp::thread_scratch_arena());
 
-        const u64 meshlets_count = meshopt_buildMeshlets(meshopt_meshlets.data(),
+        u8* meshlet_indices_ptr   = scratch.arena().allocate<u8>(indices.size());
+        u32* meshlet_vertices_ptr = scratch.arena().allocate<u32>(indices.size());
+
+        auto* meshopt_meshlets = scratch.arena().allocate<meshopt_Meshlet>(meshlets_upper_bound);
+
+        const u64 meshlets_count = meshopt_buildMeshlets(meshopt_meshlets,
                                                          meshlet_vertices_ptr,
                                                          meshlet_indices_ptr,
                                                          indices.data(),
@@ -67,19 +249,21 @@ namespace
                                                          &vertices.data()->position.x,
                                                          vertices.size(),
                                                          sizeof(static_model::vertex),
-                                                         static_model::kMaxVerticesPerMeshlet,
-                                                         static_model::kMaxTrianglesPerMeshlet,
+                                                         Config.max_vertices,
+                                                         Config.max_triangles,
                                                          0.5F);
 
-        constexpr u32 kTSAlign = shader_constants::kTaskWorkGroups;
+        // the vector is reused across lods, start from scratch so that the padding carries nothing from the last one
+        constexpr u32 kTSAlign = Config.task_work_group_size;
+        meshlets.clear();
         meshlets.resize(((meshlets_count + kTSAlign - 1) / kTSAlign) * kTSAlign);
 
         {
             ZoneScopedN("meshopt_optimizeMeshlet and data copy");
 
             u64 total_bytes_written = 0;
-            meshlets_payload.resize(meshlets_count * static_model::kMaxIndicesPerMeshlet
-                                    + meshlets_count * sizeof(u32) * static_model::kMaxVerticesPerMeshlet);
+            meshlets_payload.resize(meshlets_count * kMaxIndicesPerMeshlet
+                                    + meshlets_count * sizeof(u32) * Config.max_vertices);
 
             for (u32 i = 0; i < meshlets_count; i++)
             {
@@ -98,15 +282,33 @@ namespace
                                                  vertices.size(),
                                                  sizeof(static_model::vertex));
 
-                auto& meshlet           = meshlets[i];
-                meshlet.triangles_count = meshopt_meshlet.triangle_count;
-                meshlet.vertices_count  = meshopt_meshlet.vertex_count;
-                meshlet.payload_offset  = base_payload_offset + total_bytes_written;
+                const u32* meshlet_vertices = &meshlet_vertices_ptr[meshopt_meshlet.vertex_offset];
+                const auto [min_vertex, max_vertex] =
+                    std::minmax_element(meshlet_vertices, meshlet_vertices + meshopt_meshlet.vertex_count);
 
-                cpp::cx_memcpy(meshlets_payload.data() + total_bytes_written,
-                               &meshlet_vertices_ptr[meshopt_meshlet.vertex_offset],
-                               meshlet.vertices_count * sizeof(u32));
-                total_bytes_written += sizeof(u32) * meshlet.vertices_count;
+                auto& meshlet            = meshlets[i];
+                meshlet.triangles_count  = meshopt_meshlet.triangle_count;
+                meshlet.vertices_count   = meshopt_meshlet.vertex_count;
+                meshlet.payload_offset   = base_payload_offset + total_bytes_written;
+                meshlet.base_vertex      = *min_vertex;
+                meshlet.wide_vertex_refs = *max_vertex - *min_vertex > std::numeric_limits<u16>::max() ? 1 : 0;
+
+                // vertex references relative to base_vertex, 16 bits each unless the meshlet spans too many vertices
+                for (u32 v = 0; v < meshlet.vertices_count; ++v)
+                {
+                    const u32 local_ref = meshlet_vertices[v] - meshlet.base_vertex;
+                    if (meshlet.wide_vertex_refs)
+                    {
+                        cpp::cx_memcpy(meshlets_payload.data() + total_bytes_written, &local_ref, sizeof(u32));
+                        total_bytes_written += sizeof(u32);
+                    }
+                    else
+                    {
+                        const auto short_ref = static_cast<u16>(local_ref);
+                        cpp::cx_memcpy(meshlets_payload.data() + total_bytes_written, &short_ref, sizeof(u16));
+                        total_bytes_written += sizeof(u16);
+                    }
+                }
 
                 cpp::cx_memcpy(meshlets_payload.data() + total_bytes_written,
                                &meshlet_indices_ptr[meshopt_meshlet.triangle_offset],
@@ -116,54 +318,155 @@ namespace
                 // align data to 4 bytes to avoid payload overlaps between meshlets
                 total_bytes_written = (total_bytes_written + 3) & ~3u;
 
-                meshlet.cone_cutoff  = bounds.cone_cutoff;
-                meshlet.cone_axis[0] = bounds.cone_axis[0];
-                meshlet.cone_axis[1] = bounds.cone_axis[1];
-                meshlet.cone_axis[2] = bounds.cone_axis[2];
+                meshlet.cone_cutoff  = bounds.cone_cutoff_s8;
+                meshlet.cone_axis[0] = bounds.cone_axis_s8[0];
+                meshlet.cone_axis[1] = bounds.cone_axis_s8[1];
+                meshlet.cone_axis[2] = bounds.cone_axis_s8[2];
 
-                meshlet.sphere_radius    = bounds.radius;
-                meshlet.sphere_center[0] = bounds.center[0];
-                meshlet.sphere_center[1] = bounds.center[1];
-                meshlet.sphere_center[2] = bounds.center[2];
-            }
+                const vec3 center = (vec3(bounds.center[0], bounds.center[1], bounds.center[2]) - vec3(position_bounds))
+                                  / position_bounds.w;
+                meshlet.sphere_center[0] = encode_unorm16(center.x);
+                meshlet.sphere_center[1] = encode_unorm16(center.y);
+                meshlet.sphere_center[2] = encode_unorm16(center.z);
 
-            for (u32 i = meshlets_count; i < meshlets.size(); i++)
-            {
-                meshlets[i].vertices_count  = 0;
-                meshlets[i].triangles_count = 0;
+                // grow the radius by the worst case center rounding error, so that the sphere stays conservative
+                constexpr f32 kCenterError = 0.8661F / 65535.0F;
+                const f32 radius           = bounds.radius / position_bounds.w + kCenterError;
+
+                meshlet.sphere_radius = static_cast<u16>(glm::min(glm::ceil(radius * 65535.0F), 65535.0F));
             }
 
             // fit the array to compact the amount of data we upload to the GPU
             meshlets_payload.resize(total_bytes_written);
         }
+
+        return meshlets_count;
+    }
+
+    using build_meshlets_fn = u64 (*)(std::span<const static_model::vertex>, std::span<const u32>, const vec4&,
+                                      std::vector<static_model::meshlet>&, std::vector<u8>&, u32) noexcept;
+
+    template<u64... I>
+    constexpr std::array<build_meshlets_fn, sizeof...(I)> make_build_meshlets_table(std::index_sequence<I...>)
+    {
+        return {&build_meshlets<kMeshletConfigs[I]>...};
+    }
+
+    // one instantiation per meshlet config, picked by the geometry pool at runtime
+    constexpr auto kBuildMeshlets = make_build_meshlets_table(std::make_index_sequence<kMeshletConfigsCount>());
+}
+
+vec4 static_model::compute_position_bounds(const std::vector<vertex>& vertices)
+{
+    vec3 min(std::numeric_limits<f32>::max());
+    vec3 max(std::numeric_limits<f32>::lowest());
+    for (const auto& v : vertices)
+    {
+        min = glm::min(min, v.position);
+        max = glm::max(max, v.position);
     }
+
+    const vec3 extent = max - min;
+    return {min, glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6F))};
+}
+
+static_model::packed_vertex static_model::pack_vertex(const vertex& v, const vec4& position_bounds)
+{
+    const vec3 position = glm::clamp((v.position - vec3(position_bounds)) / position_bounds.w, 0.0F, 1.0F);
+    const vec2 normal   = encode_octahedral(v.normal);
+
+    packed_vertex result {};
+    for (u32 i = 0; i < 3; ++i)
+    {
+        result.position[i] = static_cast<u16>(glm::round(position[i] * 65535.0F));
+    }
+
+    result.normal[0] = encode_snorm8(normal.x);
+    result.normal[1] = encode_snorm8(normal.y);
+#if 0
+    result.uv[0] = glm::packHalf1x16(v.uv.x);
+    result.uv[1] = glm::packHalf1x16(v.uv.y);
+#endif
+    return result;
+}
+
+static_model::vertex static_model::unpack_vertex(const packed_vertex& v, const vec4& position_bounds)
+{
+    const vec3 position = vec3(v.position[0], v.position[1], v.position[2]) / 65535.0F;
+
+    vertex result {};
+    result.position = vec3(position_bounds) + position * position_bounds.w;
+    result.normal   = decode_octahedral({decode_snorm8(v.normal[0]), decode_snorm8(v.normal[1])});
+#if 0
+    result.uv = {glm::unpackHalf1x16(v.uv[0]), glm::unpackHalf1x16(v.uv[1])};
+#endif
+    return result;
 }
 
 result<std::vector<static_model>> static_model::load(const fs::path& path,
-                                                     render::vk_scene_geometry_pool& geometry_pool)
+                                                     render::vk_scene_geometry_pool& geometry_pool,
+                                                     cpp::job_system& jobs)
 {
     ZoneScoped;
 
     std::vector<mesh_data> model_meshes;
-    if (render::load_model<vertex>(path, model_meshes))
+    if (render::load_model<vertex>(path, model_meshes, jobs))
     {
         std::vector<static_model> models(model_meshes.size());
+        std::vector<built_geometry> geometries(model_meshes.size());
 
-        std::vector<meshlet> meshlets;
-        std::vector<u8> meshlets_payload;
+        // the meshlets pool only exists with mesh shading support
+        const bool build_meshlets_data = geometry_pool.meshlets.size > 0;
 
-        for (u32 i = 0; i < model_meshes.size(); ++i)
+        // the meshes are simplified and split into meshlets in parallel, the pools are only touched afterwards
+        auto build_geometry = [&](const u64 i)
         {
-            auto& mesh  = model_meshes[i];
-            auto& model = models[i];
+            ZoneScopedN("build geometry");
+
+            auto& mesh     = model_meshes[i];
+            auto& model    = models[i];
+            auto& geometry = geometries[i];
 
-            models[i].b_sphere = compute_bounding_sphere(mesh);
+            std::vector<meshlet> meshlets;
+            std::vector<u8> meshlets_payload;
 
-            assert2(geometry_pool.vertex.offset % sizeof(vertex) == 0);
-            models[i].base_vertex = geometry_pool.vertex.offset / sizeof(vertex);
-            upload_data(geometry_pool.transfer, geometry_pool.vertex, mesh.vertices.data(), mesh.vertices.size());
+            models[i].b_sphere        = compute_bounding_sphere(mesh);
+            models[i].position_bounds = mesh.position_bounds;
 
-            std::vector<u32> indices_work_copy = mesh.indices;
+            const auto [aabb_center, aabb_extent] = compute_bounding_box(mesh);
+            models[i].aabb_center                 = aabb_center;
+            models[i].aabb_extent                 = aabb_extent;
+
+            auto& positions  = geometry.positions;
+            auto& attributes = geometry.attributes;
+            auto append_vertices = [&](std::span<const vertex> vertices)
+            {
+                const u64 first = positions.size();
+                positions.resize(first + vertices.size());
+                attributes.resize(first + vertices.size());
+                for (u64 v = 0; v < vertices.size(); ++v)
+                {
+                    const packed_vertex packed = pack_vertex(vertices[v], mesh.position_bounds);
+                    std::copy_n(packed.position, 3, positions[first + v].position);
+                    std::copy_n(packed.normal, 2, attributes[first + v].normal);
+#if 0
+                    std::copy_n(packed.uv, 2, attributes[first + v].uv);
+#endif
+                }
+            };
+
+            append_vertices(mesh.vertices);
+
+            // all of the lods are gathered first, so that the geometry takes a single range of every pool
+            auto& indices           = geometry.indices;
+            auto& indices16         = geometry.indices16;
+            auto& geometry_meshlets = geometry.meshlets;
+            auto& geometry_payload  = geometry.meshlets_payload;
+
+            // the temporaries of every lod come from the scratch arena of the worker, reused by its next meshes
+            cpp::scratch_scope scratch(cpp::thread_scratch_arena());
+
+            cpp::arena_vector<u32> indices_work_copy(mesh.indices.begin(), mesh.indices.end(), scratch.arena());
             const f32 lod_scale =
                 meshopt_simplifyScale(&mesh.vertices[0].position.x, mesh.vertices.size(), sizeof(vertex));
 
@@ -174,33 +477,80 @@ result<std::vector<static_model>> static_model::load(const fs::path& path,
                 constexpr f32 kSimplifyAttribWeights[]  = {1.0F, 1.0F, 1.0F};
                 constexpr unsigned int kSimplifyOptions = meshopt_SimplifySparse;
 
-                build_meshlets(mesh.vertices,
-                               indices_work_copy,
-                               meshlets,
-                               meshlets_payload,
-                               geometry_pool.meshlets_payload.offset);
-
                 ++model.lod_count;
                 auto& curr_lod = model.lod_array[j];
 
                 curr_lod.lod_error = curr_error * lod_scale;
 
-                assert2(geometry_pool.index.offset % sizeof(u32) == 0);
-                assert2(geometry_pool.meshlets.offset % sizeof(meshlet) == 0);
+                // Simplified lods reference a small subset of the mesh vertices. When compacted, they fetch a copy of
+                // just that subset in their own fetch order instead, appended to the vertices of the geometry
+                std::span<const vertex> lod_vertices = mesh.vertices;
+                std::span<const u32> lod_indices     = indices_work_copy;
 
-                curr_lod.meshlets_count = meshlets.size();
-                curr_lod.base_meshlet   = geometry_pool.meshlets.offset / sizeof(meshlet);
+                cpp::scratch_scope lod_scratch(scratch.arena());
+                if (geometry_pool.compact_lod_vertices && j > 0)
+                {
+                    auto* remap              = lod_scratch.arena().allocate<u32>(mesh.vertices.size());
+                    const u64 vertices_count = meshopt_optimizeVertexFetchRemap(
+                        remap, indices_work_copy.data(), indices_work_copy.size(), mesh.vertices.size());
 
-                curr_lod.indices_count = indices_work_copy.size();
-                curr_lod.base_index    = geometry_pool.index.offset / sizeof(u32);
+                    auto* compacted_indices = lod_scratch.arena().allocate<u32>(indices_work_copy.size());
+                    meshopt_remapIndexBuffer(
+                        compacted_indices, indices_work_copy.data(), indices_work_copy.size(), remap);
 
-                upload_data(geometry_pool.transfer, geometry_pool.meshlets, meshlets.data(), meshlets.size());
-                upload_data(
-                    geometry_pool.transfer, geometry_pool.index, indices_work_copy.data(), indices_work_copy.size());
-                upload_data(geometry_pool.transfer,
-                            geometry_pool.meshlets_payload,
-                            meshlets_payload.data(),
-                            meshlets_payload.size());
+                    auto* compacted_vertices = lod_scratch.arena().allocate<vertex>(vertices_count);
+                    meshopt_remapVertexBuffer(
+                        compacted_vertices, mesh.vertices.data(), mesh.vertices.size(), sizeof(vertex), remap);
+
+                    lod_vertices = {compacted_vertices, vertices_count};
+                    lod_indices  = {compacted_indices, indices_work_copy.size()};
+
+                    curr_lod.base_vertex = positions.size();
+                    append_vertices(lod_vertices);
+                }
+
+                // lod references are relative to the geometry ranges until they are allocated below
+                if (build_meshlets_data)
+                {
+                    const u64 built_count =
+                        kBuildMeshlets[geometry_pool.meshlet_config_index](lod_vertices,
+                                                                           lod_indices,
+                                                                           mesh.position_bounds,
+                                                                           meshlets,
+                                                                           meshlets_payload,
+                                                                           geometry_payload.size());
+
+                    // the task shader has no lod at hand, so the meshlets carry its vertex offset themselves,
+                    // the padding stays empty
+                    for (u64 m = 0; m < built_count; m++)
+                    {
+                        meshlets[m].base_vertex += curr_lod.base_vertex;
+                    }
+
+                    curr_lod.meshlets_count = meshlets.size();
+                    curr_lod.base_meshlet   = geometry_meshlets.size();
+
+                    geometry_meshlets.insert(geometry_meshlets.end(), meshlets.begin(), meshlets.end());
+                    geometry_payload.insert(geometry_payload.end(), meshlets_payload.begin(), meshlets_payload.end());
+                }
+
+                // indices are relative to the lod vertices, so any lod referencing less than 64k vertices fits u16
+                const u32 max_index =
+                    lod_indices.empty() ? 0 : *std::max_element(lod_indices.begin(), lod_indices.end());
+
+                curr_lod.indices_count = lod_indices.size();
+                curr_lod.short_indices = max_index <= std::numeric_limits<u16>::max() ? 1 : 0;
+
+                if (curr_lod.short_indices)
+                {
+                    curr_lod.base_index = indices16.size();
+                    indices16.insert(indices16.end(), lod_indices.begin(), lod_indices.end());
+                }
+                else
+                {
+                    curr_lod.base_index = indices.size();
+                    indices.insert(indices.end(), lod_indices.begin(), lod_indices.end());
+                }
 
                 if (j == COUNT_OF(lod_array) - 1)
                 {
@@ -239,9 +589,110 @@ result<std::vector<static_model>> static_model::load(const fs::path& path,
                 meshopt_optimizeVertexCache(
                     indices_work_copy.data(), indices_work_copy.data(), indices_work_copy.size(), mesh.vertices.size());
             }
+        };
+
+        jobs.parallel_for(model_meshes.size(), 1, build_geometry);
+
+        for (u32 i = 0; i < model_meshes.size(); ++i)
+        {
+            auto& model    = models[i];
+            auto& geometry = geometries[i];
+
+            auto& positions         = geometry.positions;
+            auto& attributes        = geometry.attributes;
+            auto& indices           = geometry.indices;
+            auto& indices16         = geometry.indices16;
+            auto& geometry_meshlets = geometry.meshlets;
+            auto& geometry_payload  = geometry.meshlets_payload;
+
+            // only the representation of the active draw path is uploaded, see render::set_geometry_residency
+            const bool indexed_resident = geometry_pool.residency == geometry_residency::indexed;
+            assert2(indexed_resident || build_meshlets_data);
+
+            const auto allocation = allocate_geometry(geometry_pool,
+                                                      positions.size(),
+                                                      indexed_resident ? indices.size() : 0,
+                                                      indexed_resident ? indices16.size() : 0,
+                                                      indexed_resident ? 0 : geometry_meshlets.size(),
+                                                      indexed_resident ? 0 : geometry_payload.size());
+            if (!allocation)
+            {
+                for (u32 k = 0; k < i; ++k)
+                {
+                    unload(models[k], geometry_pool);
+                }
+
+                return allocation.message;
+            }
+
+            assert2(allocation->attribute.offset / sizeof(packed_attributes)
+                    == allocation->position.offset / sizeof(packed_position));
+            model.base_vertex = allocation->position.offset / sizeof(packed_position);
+
+            for (u32 j = 0; j < model.lod_count; ++j)
+            {
+                auto& lod = model.lod_array[j];
+                lod.base_index += lod.short_indices ? allocation->index16.offset / sizeof(u16)
+                                                    : allocation->index.offset / sizeof(u32);
+                lod.base_meshlet += allocation->meshlets.offset / sizeof(meshlet);
+            }
+
+            vk_geometry_host_data host_data;
+            host_data.meshlets.resize(geometry_meshlets.size() * sizeof(meshlet));
+            std::memcpy(host_data.meshlets.data(), geometry_meshlets.data(), host_data.meshlets.size());
+
+            upload_data(geometry_pool.transfer, geometry_pool.position, allocation->position, positions);
+            upload_data(geometry_pool.transfer, geometry_pool.attribute, allocation->attribute, attributes);
+
+            if (indexed_resident)
+            {
+                upload_data(geometry_pool.transfer, geometry_pool.index, allocation->index, indices);
+                upload_data(geometry_pool.transfer, geometry_pool.index16, allocation->index16, indices16);
+            }
+            else
+            {
+                for (auto& m : geometry_meshlets)
+                {
+                    m.payload_offset += allocation->meshlets_payload.offset;
+                }
+
+                upload_data(geometry_pool.transfer, geometry_pool.meshlets, allocation->meshlets, geometry_meshlets);
+                upload_data(geometry_pool.transfer,
+                            geometry_pool.meshlets_payload,
+                            allocation->meshlets_payload,
+                            geometry_payload);
+            }
+
+            host_data.indices          = std::move(indices);
+            host_data.indices16        = std::move(indices16);
+            host_data.meshlets_payload = std::move(geometry_payload);
+
+            model.geometry_id = add_geometry(geometry_pool, *allocation, std::move(host_data));
         }
         return models;
     }
 
     return "failed to parse the model";
 }
+
+void static_model::unload(const static_model& model, render::vk_scene_geometry_pool& geometry_pool)
+{
+    render::free_geometry(geometry_pool, model.geometry_id);
+}
+
+void static_model::relocate(const render::vk_geometry_relocation& relocation)
+{
+    // mirrors geometry_relocate.comp
+    auto add = [](u32 value, i32 delta)
+    {
+        return static_cast<u32>(static_cast<i64>(value) + delta);
+    };
+
+    base_vertex = add(base_vertex, relocation.vertex_delta);
+    for (u32 i = 0; i < lod_count; ++i)
+    {
+        auto& lod        = lod_array[i];
+        lod.base_index   = add(lod.base_index, lod.short_indices ? relocation.index16_delta : relocation.index_delta);
+        lod.base_meshlet = add(lod.base_meshlet, relocation.meshlet_delta);
+    }
+}
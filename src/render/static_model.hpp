@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cpp/jobs/job_system.hpp>
 #include <fs/path.hpp>
 #include <render/platform/vk/vk_buffer.hpp>
 #include <render/platform/vk/vk_geometry_pool.hpp>
@@ -9,10 +10,6 @@
 
 struct static_model
 {
-    constexpr static u32 kMaxIndicesPerMeshlet   = shader_constants::kMaxIndicesPerMeshlet;
-    constexpr static u32 kMaxVerticesPerMeshlet  = shader_constants::kMaxVerticesPerMeshlet;
-    constexpr static u32 kMaxTrianglesPerMeshlet = shader_constants::kMaxTrianglesPerMeshlet;
-
     constexpr static u32 kLODCount = shader_constants::kLODCount;
 
     struct alignas(4) lod
@@ -22,17 +19,22 @@ struct static_model
         u32 base_index;      // Only used for non-meshlets path
         u32 indices_count;   // Only used for non-meshlets path
         f32 lod_error;
+        u32 short_indices;   // Only used for non-meshlets path, 1 if the indices are u16 and live in index16
+        u32 base_vertex;     // Only used for non-meshlets path, first vertex of the lod past static_model::base_vertex
     };
 
     struct meshlet
     {
-        u32 payload_offset;  // offset to the meshlet payload in a shared array
-        f32 cone_axis[3];
-        f32 cone_cutoff;
-        f32 sphere_center[3];
-        f32 sphere_radius;
+        u32 payload_offset;    // offset to the meshlet payload in a shared array
+        u32 base_vertex;       // smallest mesh vertex referenced, payload vertex references are relative to it
+        u16 sphere_center[3];  // unorm16 within the mesh position bounds
+        u16 sphere_radius;     // unorm16 of the mesh bounds extent, rounded up
+        i8 cone_axis[3];       // snorm8, see meshopt_Bounds::cone_axis_s8
+        i8 cone_cutoff;        // snorm8, see meshopt_Bounds::cone_cutoff_s8
         u8 vertices_count;
         u8 triangles_count;
+        u8 wide_vertex_refs;  // 1 if the vertex references span more than 16 bits and are stored as u32
+        u8 padding;
     };
 
     struct vertex
@@ -45,11 +47,53 @@ struct static_model
 #endif
     };
 
+    // cache layout of a vertex, split into the position and attribute streams on upload
+    struct packed_vertex
+    {
+        u16 position[3];  // unorm16 within the mesh position bounds
+        i8 normal[2];     // snorm8 octahedral encoding
+#if 0
+        u16 uv[2];        // half floats
+#endif
+    };
+
+    // GPU position stream, the only vertex data fetched by depth-only passes, decoded in types.glsl
+    struct packed_position
+    {
+        u16 position[3];
+    };
+
+    // GPU attribute stream, indexed by the same vertex index as the position stream, decoded in types.glsl
+    struct packed_attributes
+    {
+        i8 normal[2];
+#if 0
+        u16 uv[2];
+#endif
+    };
+
     using mesh_data = render::mesh_data<vertex>;
-    static result<std::vector<static_model>> load(const fs::path& path, render::vk_scene_geometry_pool& geometry_pool);
+    // the meshes are built in parallel on the jobs, the pools are only touched from the calling thread
+    static result<std::vector<static_model>> load(const fs::path& path, render::vk_scene_geometry_pool& geometry_pool,
+                                                  cpp::job_system& jobs);
+
+    // frees the pool ranges of the geometry, every copy of the model becomes invalid
+    static void unload(const static_model& model, render::vk_scene_geometry_pool& geometry_pool);
+
+    // patches the pool references after render::defragment_geometry_pool moved the geometry
+    void relocate(const render::vk_geometry_relocation& relocation);
+
+    // xyz - min corner, w - largest extent
+    static vec4 compute_position_bounds(const std::vector<vertex>& vertices);
+    static packed_vertex pack_vertex(const vertex& v, const vec4& position_bounds);
+    static vertex unpack_vertex(const packed_vertex& v, const vec4& position_bounds);
 
     vec4 b_sphere;
-    u32 base_vertex {0};
+    vec4 position_bounds;  // dequantizes packed_vertex::position
+    vec3 aabb_center;      // object space box, tighter than b_sphere for elongated meshes
+    vec3 aabb_extent;      // half extents
+    u32 base_vertex {0};  // shared by the position and attribute streams
     u32 lod_count {0};
+    u32 geometry_id {0};  // unique index of the geometry within the pool, used to bin instances
     lod lod_array[kLODCount];
 };
@@ -1,6 +1,15 @@
 #include <cpp/math.hpp>
 #include <scene/components.hpp>
 
+id_component::id_component(const u64 restored_id)
+    : id(restored_id)
+{
+    u64 next = id_counter.load(std::memory_order_relaxed);
+    while (next <= restored_id && !id_counter.compare_exchange_weak(next, restored_id + 1, std::memory_order_relaxed))
+    {
+    }
+}
+
 glm::vec3 camera_component::get_up(const glm::quat& rotation) const noexcept
 {
     constexpr vec3 up = vec3(0.0F, 1.0F, 0.0F);
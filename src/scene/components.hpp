@@ -8,7 +8,7 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
-#include <render/static_model.hpp>
+#include <render/model_registry.hpp>
 
 /// @imgui
 struct transform_component
@@ -21,7 +21,20 @@ struct transform_component
 /// @imgui
 struct static_model_component
 {
-    static_model model;
+    /// @readonly
+    u32 handle {render::model_registry::kInvalidHandle};  // record of the model in the render::model_registry
+};
+
+/// @imgui
+struct gpu_instance_component
+{
+    /// @readonly
+    u32 index {0};  // slot of the instance in the per-instance gpu tables
+};
+
+// set on the entities which transform_component was patched through the scene, cleared once the change is uploaded
+struct transform_dirty_tag
+{
 };
 
 /// @imgui
@@ -42,6 +55,9 @@ struct id_component
     id_component() = default;
     DEBUG_ONLY(id_component(const cpp::stack_string& name) : name(name) {});
 
+    // id of an entity restored from a saved scene, the ids handed out afterwards stay above it
+    explicit id_component(u64 restored_id);
+
 private:
     /// @hide
     inline static std::atomic<u64> id_counter;
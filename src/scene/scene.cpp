@@ -1,6 +1,13 @@
+#include <scene/components.hpp>
 #include <scene/entity.hpp>
 #include <scene/scene.hpp>
 
+scene::scene()
+{
+    // patched transforms are collected for the incremental upload of the meshes transforms table
+    m_registry.on_update<transform_component>().connect<&entt::registry::emplace_or_replace<transform_dirty_tag>>();
+}
+
 entity scene::create_entity()
 {
     return entity(m_registry.create(), m_registry);
@@ -10,3 +17,14 @@ void scene::delete_entity(entity& entity)
 {
     m_registry.destroy(entity.m_entity);
 }
+
+void scene::delete_entity(const entt::entity entity)
+{
+    m_registry.destroy(entity);
+}
+
+void scene::delete_entities(const std::span<const entt::entity> entities)
+{
+    ZoneScoped;
+    m_registry.destroy(entities.begin(), entities.end());
+}
@@ -1,16 +1,47 @@
 #pragma once
 
+#include <types.hpp>
+
+#include <assert2.hpp>
 #include <entt/entt.hpp>
+#include <tracy/Tracy.hpp>
+
+#include <span>
+#include <type_traits>
+#include <vector>
 
 class entity;
 
 class scene
 {
 public:
+    scene();
+
     entity create_entity();
 
     void delete_entity(entity& entity);
 
+    void delete_entity(entt::entity entity);
+
+    // Creates count entities at once, the i-th one gets the i-th element of every span. Each storage is filled by a
+    // single insert instead of an emplace per entity.
+    template<typename... Components>
+    std::vector<entt::entity> create_entities(const u64 count,
+                                              std::span<const std::type_identity_t<Components>>... components)
+    {
+        ZoneScoped;
+
+        assert2(((components.size() == count) && ...));
+
+        std::vector<entt::entity> entities(count);
+        m_registry.create(entities.begin(), entities.end());
+        (m_registry.insert<Components>(entities.begin(), entities.end(), components.begin()), ...);
+
+        return entities;
+    }
+
+    void delete_entities(std::span<const entt::entity> entities);
+
     template<typename... Components>
     auto get_view()
     {
@@ -23,6 +54,12 @@ public:
         return m_registry.view<Components...>();
     }
 
+    template<typename... Components, typename... Exclude>
+    auto get_view(entt::exclude_t<Exclude...> exclude)
+    {
+        return m_registry.view<Components...>(exclude);
+    }
+
     template<typename T>
     [[nodiscard]] T& get_component(entt::entity entity)
     {
@@ -36,11 +73,38 @@ public:
     }
 
     template<typename T, typename... Args>
-    T& add_component(entt::entity entity, Args&&... args) const
+    T& add_component(entt::entity entity, Args&&... args)
     {
         return m_registry.emplace<T>(entity, std::forward<Args>(args)...);
     }
 
+    // writes through get_component are invisible to the registry, changes made here notify the on_update listeners
+    template<typename T, typename... Func>
+    T& patch_component(entt::entity entity, Func&&... func)
+    {
+        return m_registry.patch<T>(entity, std::forward<Func>(func)...);
+    }
+
+    template<typename T>
+    void clear_component()
+    {
+        m_registry.clear<T>();
+    }
+
+    // fires once a T is added to an entity, bulk inserts included
+    template<typename T>
+    auto on_construct()
+    {
+        return m_registry.on_construct<T>();
+    }
+
+    // fires right before a T is removed from an entity, the entity and its T are still valid in the listeners
+    template<typename T>
+    auto on_destroy()
+    {
+        return m_registry.on_destroy<T>();
+    }
+
 private:
     entt::registry m_registry;
 };
@@ -0,0 +1,238 @@
+#include <assert2.hpp>
+#include <cpp/alg_constexpr.hpp>
+#include <cpp/hash/hashed_string.hpp>
+#include <fs/fs.hpp>
+#include <scene/components.hpp>
+#include <scene/scene.hpp>
+#include <scene/serializer.hpp>
+#include <tracy/Tracy.hpp>
+
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    constexpr u64 kSceneMagic   = "gdr_scene"_hs;
+    constexpr u32 kSceneVersion = 1;
+
+    // every block starts at this alignment within the file
+    constexpr u64 kBlockAlignment = 16;
+
+    // the transforms block is handed to the registry straight from the file memory
+    static_assert(std::is_trivially_copyable_v<transform_component>);
+    static_assert(alignof(transform_component) <= kBlockAlignment);
+
+    struct scene_header
+    {
+        u64 magic {kSceneMagic};
+        u32 version {kSceneVersion};
+        u32 models_count {0};
+        u64 instances_count {0};
+        u64 size {0};  // of the whole file, to catch truncated ones
+
+        u64 models_offset {0};         // model_entry[models_count]
+        u64 paths_offset {0};          // chars the model entries point into
+        u64 transforms_offset {0};     // transform_component[instances_count]
+        u64 model_indices_offset {0};  // u32[instances_count], into the models block
+        u64 ids_offset {0};            // u64[instances_count], id_component::id
+    };
+
+    struct model_entry
+    {
+        u64 content_hash {0};
+        u32 mesh_index {0};
+        u32 path_offset {0};  // relative to paths_offset
+        u32 path_length {0};
+        u32 padding {0};
+    };
+
+    constexpr u64 align_block(const u64 offset)
+    {
+        return (offset + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+    }
+
+    bool block_in_file(const scene_header& header, const u64 offset, const u64 size)
+    {
+        return offset % kBlockAlignment == 0 && offset <= header.size && size <= header.size - offset;
+    }
+}
+
+result<bytes> serialize_scene(const scene& scene, const render::model_registry& models)
+{
+    ZoneScoped;
+
+    std::vector<transform_component> transforms;
+    std::vector<u32> model_indices;
+    std::vector<u64> ids;
+
+    // registry handle to the index of its entry in the models block
+    std::unordered_map<u32, u32> model_entries;
+    std::vector<model_entry> entries;
+    std::string paths;
+
+    auto&& view = scene.get_view<const transform_component, const static_model_component, const id_component>();
+    view.each(
+        [&](const transform_component& tc, const static_model_component& smc, const id_component& idc)
+        {
+            auto [entry, inserted] = model_entries.try_emplace(smc.handle, static_cast<u32>(entries.size()));
+            if (inserted)
+            {
+                const auto& origin = models.records[smc.handle].origin;
+                entries.push_back(model_entry {
+                    .content_hash = origin.content_hash,
+                    .mesh_index   = origin.mesh_index,
+                    .path_offset  = static_cast<u32>(paths.size()),
+                    .path_length  = static_cast<u32>(origin.path.length()),
+                });
+                paths.append(origin.path.c_str(), origin.path.length());
+            }
+
+            transforms.push_back(tc);
+            model_indices.push_back(entry->second);
+            ids.push_back(idc.id);
+        });
+
+    for (const model_entry& entry : entries)
+    {
+        if (entry.path_length == 0)
+        {
+            return "serialize_scene: the scene references a model that was not loaded from a file";
+        }
+    }
+
+    const u64 count = transforms.size();
+
+    scene_header header {
+        .models_count    = static_cast<u32>(entries.size()),
+        .instances_count = count,
+    };
+
+    header.models_offset        = align_block(sizeof(scene_header));
+    header.paths_offset         = align_block(header.models_offset + entries.size() * sizeof(model_entry));
+    header.transforms_offset    = align_block(header.paths_offset + paths.size());
+    header.model_indices_offset = align_block(header.transforms_offset + count * sizeof(transform_component));
+    header.ids_offset           = align_block(header.model_indices_offset + count * sizeof(u32));
+    header.size                 = header.ids_offset + count * sizeof(u64);
+
+    bytes result {header.size};
+    auto write = [&](const u64 offset, const void* data, const u64 size)
+    {
+        cpp::cx_memcpy(result.get<u8>() + offset, data, size);
+    };
+
+    write(0, &header, sizeof(header));
+    write(header.models_offset, entries.data(), entries.size() * sizeof(model_entry));
+    write(header.paths_offset, paths.data(), paths.size());
+    write(header.transforms_offset, transforms.data(), count * sizeof(transform_component));
+    write(header.model_indices_offset, model_indices.data(), count * sizeof(u32));
+    write(header.ids_offset, ids.data(), count * sizeof(u64));
+
+    return result;
+}
+
+result<u64> load_scene(const fs::path& path, scene& scene, render::model_registry& models,
+                       render::vk_scene_geometry_pool& geometry_pool, cpp::job_system& jobs)
+{
+    ZoneScoped;
+
+    // a single read of the whole file, the blocks are used in place from its memory
+    const auto file = fs::read_file(path);
+    if (!file)
+    {
+        return file.message;
+    }
+
+    const u8* data = file->get<u8>();
+
+    scene_header header;
+    if (file->size() < sizeof(scene_header))
+    {
+        return "load_scene: not a scene file";
+    }
+
+    cpp::cx_memcpy(&header, data, sizeof(header));
+    if (header.magic != kSceneMagic || header.version != kSceneVersion)
+    {
+        return "load_scene: not a scene file or an unsupported version";
+    }
+
+    // a count no file of this size can hold would wrap the block sizes below, the transforms are the largest of them
+    static_assert(sizeof(transform_component) >= sizeof(u64));
+    const u64 count = header.instances_count;
+    if (count > header.size / sizeof(transform_component))
+    {
+        return "load_scene: corrupted file";
+    }
+
+    const bool blocks_in_file =
+        block_in_file(header, header.models_offset, header.models_count * sizeof(model_entry))
+        && block_in_file(header, header.paths_offset, 0)
+        && block_in_file(header, header.transforms_offset, count * sizeof(transform_component))
+        && block_in_file(header, header.model_indices_offset, count * sizeof(u32))
+        && block_in_file(header, header.ids_offset, count * sizeof(u64));
+
+    if (header.size != file->size() || !blocks_in_file)
+    {
+        return "load_scene: corrupted file";
+    }
+
+    const std::span entries(reinterpret_cast<const model_entry*>(data + header.models_offset), header.models_count);
+    const std::span transforms(reinterpret_cast<const transform_component*>(data + header.transforms_offset), count);
+    const std::span model_indices(reinterpret_cast<const u32*>(data + header.model_indices_offset), count);
+    const std::span ids(reinterpret_cast<const u64*>(data + header.ids_offset), count);
+
+    // every mesh of a file is loaded along with the first entry that needs it, the rest are found in the registry
+    std::vector<u32> handles(entries.size(), render::model_registry::kInvalidHandle);
+    for (u32 i = 0; i < entries.size(); ++i)
+    {
+        const model_entry& entry = entries[i];
+
+        handles[i] = models.find(entry.content_hash, entry.mesh_index);
+        if (handles[i] != render::model_registry::kInvalidHandle)
+        {
+            continue;
+        }
+
+        if (!block_in_file(header, header.paths_offset, u64(entry.path_offset) + entry.path_length))
+        {
+            return "load_scene: corrupted file";
+        }
+
+        const std::string model_path(reinterpret_cast<const char*>(data + header.paths_offset + entry.path_offset),
+                                     entry.path_length);
+        if (!models.load(model_path, geometry_pool, jobs))
+        {
+            return "load_scene: failed to load a model of the scene";
+        }
+
+        handles[i] = models.find(entry.content_hash, entry.mesh_index);
+        if (handles[i] == render::model_registry::kInvalidHandle)
+        {
+            return "load_scene: a model of the scene changed since it was saved";
+        }
+    }
+
+    std::vector<static_model_component> model_components;
+    std::vector<id_component> id_components;
+    model_components.reserve(count);
+    id_components.reserve(count);
+
+    for (u64 i = 0; i < count; ++i)
+    {
+        if (model_indices[i] >= handles.size())
+        {
+            return "load_scene: corrupted file";
+        }
+
+        model_components.push_back(static_model_component {.handle = handles[model_indices[i]]});
+        id_components.emplace_back(ids[i]);
+    }
+
+    scene.create_entities<static_model_component, id_component, transform_component>(
+        count, model_components, id_components, transforms);
+
+    return count;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <bytes.hpp>
+#include <fs/path.hpp>
+#include <render/model_registry.hpp>
+#include <result.hpp>
+
+class scene;
+
+// Binary scene: a header, the table of the models the instances use and one block per instance component (SoA), each
+// block aligned so it can be read in place from the file memory. Models are referenced by the content hash of the
+// file they were built from and the mesh index within it, the path is only a hint where to load them from.
+result<bytes> serialize_scene(const scene& scene, const render::model_registry& models);
+
+// Loads the models the file references (the ones already in the registry are reused) and spawns its instances in
+// bulk. Nothing is spawned if the file is corrupted or one of the models changed since the scene was saved.
+// Returns the number of instances spawned.
+result<u64> load_scene(const fs::path& path, scene& scene, render::model_registry& models,
+                       render::vk_scene_geometry_pool& geometry_pool, cpp::job_system& jobs);